@@ -0,0 +1,64 @@
+/***********************************************************************************************************************
+   @file   host.cpp
+   @brief  Arduino time functions and trace import of the host builds.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "host.h"
+#include <chrono>
+#include <stdio.h>
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+unsigned long HostSendCount = 0;
+
+static const std::chrono::steady_clock::time_point HostStart = std::chrono::steady_clock::now();
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Time since start of the host program.
+ */
+unsigned long micros(void)
+{
+    return static_cast<unsigned long>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - HostStart).count());
+}
+
+unsigned long millis(void) { return micros() / 1000; }
+
+/***********************************************************************************************************************
+ * Read a record from a line written by WmcCvTrace::Format. Other lines of the serial log are refused.
+ */
+bool HostTraceParse(const char* Line, cvTraceRecord& Record)
+{
+    unsigned long TimeStamp;
+    unsigned int Kind;
+    unsigned int State;
+    unsigned int Data;
+    unsigned int Number;
+    unsigned int Address;
+    unsigned int Value;
+
+    if (sscanf(Line, " cvtrace %lu %u %u %u %u %u %u", &TimeStamp, &Kind, &State, &Data, &Number, &Address, &Value)
+        != 7)
+    {
+        return false;
+    }
+
+    Record.TimeStamp = static_cast<uint32_t>(TimeStamp);
+    Record.Kind      = static_cast<uint8_t>(Kind);
+    Record.State     = static_cast<uint8_t>(State);
+    Record.Data      = static_cast<uint8_t>(Data);
+    Record.Number    = static_cast<uint16_t>(Number);
+    Record.Address   = static_cast<uint16_t>(Address);
+    Record.Value     = static_cast<uint8_t>(Value);
+
+    return true;
+}
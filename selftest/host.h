@@ -0,0 +1,23 @@
+/**
+ **********************************************************************************************************************
+ * @file  host.h
+ * @brief Arduino time functions and trace import of the host builds.
+ ***********************************************************************************************************************
+ */
+#ifndef HOST_H
+#define HOST_H
+
+/***********************************************************************************************************************
+ * I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv_trace.h"
+
+/***********************************************************************************************************************
+ * F U N C T I O N S
+ **********************************************************************************************************************/
+
+bool HostTraceParse(const char* Line, cvTraceRecord& Record);
+
+extern unsigned long HostSendCount; /* Number of events send to the other modules. */
+
+#endif
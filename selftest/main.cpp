@@ -0,0 +1,533 @@
+/***********************************************************************************************************************
+   @file   main.cpp
+   @brief  Host runner of the cv module self test.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "host.h"
+#include "wmc_cv_program.h"
+#include "wmc_cv_selftest.h"
+#include <stdio.h>
+
+/***********************************************************************************************************************
+   D E F I N E S
+ **********************************************************************************************************************/
+
+/* Number of seeds and events per seed of the random event test. */
+#define HOST_SEEDS 50
+#define HOST_EVENTS 200000
+
+/* Number of cv's of the decoder answering the program runner. */
+#define HOST_DECODER_CVS 256
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+static cvProgramCheckpoint HostCheckpoint;    /* Checkpoint "flash" of the program runner. */
+static uint8_t HostDecoder[HOST_DECODER_CVS]; /* Cv's of the decoder on the programming track. */
+static uint8_t HostWrites[HOST_DECODER_CVS];  /* Number of writes per cv. */
+static uint16_t HostNackCv = 0;               /* Writes of this cv are answered with a nack. */
+static cvProgEvent HostRequest;               /* Request of the job not answered yet. */
+static bool HostRequestPending  = false;       /* HostRequest valid. */
+static uint16_t HostTransitions = 0;         /* Number of transitions seen during the replay. */
+static const char* HostTest     = "";        /* Name of the running test, for the failure report. */
+
+static const cvJobStep HostProgramSteps[] = { { 1, 3, cvJobWrite }, { 3, 10, cvJobWrite }, { 4, 12, cvJobWrite },
+    { 8, 8, cvJobRead } };
+static const cvJobStep HostProgramEdited[] = { { 1, 3, cvJobWrite }, { 3, 20, cvJobWrite }, { 4, 12, cvJobWrite },
+    { 8, 8, cvJobRead } };
+static const cvProgram HostProgram     = { "FLEET", HostProgramSteps, 4 };
+static const cvProgram HostProgramEdit = { "FLEET", HostProgramEdited, 4 };
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Checkpoint storage of the program runner.
+ */
+static bool HostCheckpointRead(cvProgramCheckpoint& Checkpoint)
+{
+    Checkpoint = HostCheckpoint;
+    return true;
+}
+
+static void HostCheckpointWrite(cvProgramCheckpoint const& Checkpoint) { HostCheckpoint = Checkpoint; }
+
+/***********************************************************************************************************************
+ * Requests to the command station, answered after the dispatch by HostReply().
+ */
+static void HostSink(cvProgEvent const& Event)
+{
+    if ((Event.Request == cvRead) || (Event.Request == cvWrite))
+    {
+        HostRequest        = Event;
+        HostRequestPending = true;
+    }
+}
+
+/***********************************************************************************************************************
+ * Command station with one decoder on the programming track, answers the outstanding request. Returns false when no
+ * request was outstanding.
+ */
+static bool HostReply(void)
+{
+    cvEvent Event;
+
+    if (HostRequestPending == false)
+    {
+        return false;
+    }
+
+    uint8_t& Cv = HostDecoder[HostRequest.CvNumber % HOST_DECODER_CVS];
+
+    HostRequestPending = false;
+    Event.cvNumber     = HostRequest.CvNumber;
+    Event.EventData    = cvData;
+
+    if (HostRequest.Request == cvWrite)
+    {
+        HostWrites[HostRequest.CvNumber % HOST_DECODER_CVS]++;
+        Event.EventData = responseReady;
+        if (HostRequest.CvNumber == HostNackCv)
+        {
+            Event.EventData = cvNack;
+        }
+        else
+        {
+            Cv = HostRequest.CvValue;
+        }
+    }
+
+    Event.cvValue = Cv;
+    wmcCv::dispatch(Event);
+
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Let the job run, at most Answers requests of the job are answered. Returns the number of answered requests.
+ */
+static uint16_t HostAnswer(uint16_t Answers)
+{
+    cvEvent Event;
+    uint16_t Answered = 0;
+
+    for (uint16_t Tick = 0; (Tick < 100) && (Answered < Answers) && (wmcCv::JobActive() == true); Tick++)
+    {
+        Event.EventData = update;
+        wmcCv::dispatch(Event);
+
+        while ((Answered < Answers) && (HostReply() == true))
+        {
+            Answered++;
+        }
+    }
+
+    return Answered;
+}
+
+/***********************************************************************************************************************
+ * New decoder on the programming track, optionally with a cv which can not be written.
+ */
+static void HostDecoderNew(uint16_t NackCv)
+{
+    for (uint16_t Index = 0; Index < HOST_DECODER_CVS; Index++)
+    {
+        HostDecoder[Index] = 0;
+        HostWrites[Index]  = 0;
+    }
+    HostDecoder[8]     = 8;
+    HostNackCv         = NackCv;
+    HostRequestPending = false;
+}
+
+/***********************************************************************************************************************
+ * Report a failed check of the running test.
+ */
+static int HostCheck(bool Ok, const char* Text)
+{
+    if (Ok == false)
+    {
+        printf("%s: %s\n", HostTest, Text);
+        return 1;
+    }
+    return 0;
+}
+
+/***********************************************************************************************************************
+ * Program runner: resume after Stop() and after a power cycle, no resume after a failure or for an edited program and
+ * Clear(). Returns the number of failed checks.
+ */
+static int HostProgramTest(void)
+{
+    int Failures = 0;
+
+    HostTest = "program runner";
+    wmcCv::SetProgEventSink(HostSink);
+    wmcCv::Reset();
+    HostCheckpoint.ProgramId = 0;
+    HostCheckpoint.NextStep  = 0;
+    WmcCvProgram::Init(HostCheckpointRead, HostCheckpointWrite);
+
+    /* Complete run. */
+    HostDecoderNew(0);
+    Failures += HostCheck(WmcCvProgram::Start(HostProgram) == true, "start refused");
+    HostAnswer(10);
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramDone, "complete run not done");
+    Failures
+        += HostCheck((HostDecoder[1] == 3) && (HostDecoder[3] == 10) && (HostDecoder[4] == 12), "cv's not written");
+    Failures += HostCheck(HostCheckpoint.ProgramId == 0, "checkpoint kept after completion");
+
+    /* Stopped after 2 steps, resumes at the third step. */
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(2);
+    WmcCvProgram::Stop();
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramIdle, "stop not idle");
+    Failures += HostCheck(WmcCvProgram::Start(HostProgram) == true, "restart after stop refused");
+    Failures += HostCheck(WmcCvProgram::Done() == 2, "no resume after stop");
+    HostAnswer(10);
+    Failures += HostCheck((WmcCvProgram::Status() == cvProgramDone) && (HostWrites[1] == 1) && (HostWrites[3] == 1)
+            && (HostWrites[4] == 1),
+        "resumed run not done or steps repeated");
+
+    /* Power cycle after one step, the job is gone and the runner resumes from the checkpoint. */
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(1);
+    wmcCv::Reset();
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramIdle, "running after power cycle");
+    WmcCvProgram::Start(HostProgram);
+    Failures += HostCheck(WmcCvProgram::Done() == 1, "no resume after power cycle");
+    HostAnswer(10);
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramDone, "resumed run after power cycle not done");
+
+    /* Nack on the second step, the replaced decoder starts at the first step. */
+    HostDecoderNew(3);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(10);
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramFailed, "nack not failed");
+    Failures += HostCheck(HostCheckpoint.ProgramId == 0, "checkpoint kept after failure");
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    Failures += HostCheck(WmcCvProgram::Done() == 0, "resume after failure");
+    HostAnswer(10);
+    Failures += HostCheck((WmcCvProgram::Status() == cvProgramDone) && (HostWrites[1] == 1), "run after failure");
+
+    /* Verify mismatch fails the program. */
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(3);
+    HostDecoder[8] = 9;
+    HostAnswer(10);
+    Failures += HostCheck(WmcCvProgram::Status() == cvProgramFailed, "verify mismatch not failed");
+
+    /* Edited program with the same name does not resume at the checkpoint of the old one. */
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(2);
+    WmcCvProgram::Stop();
+    WmcCvProgram::Start(HostProgramEdit);
+    Failures += HostCheck(WmcCvProgram::Done() == 0, "edited program resumed");
+    WmcCvProgram::Stop();
+
+    /* Clear starts at the first step. */
+    HostDecoderNew(0);
+    WmcCvProgram::Start(HostProgram);
+    HostAnswer(2);
+    WmcCvProgram::Clear();
+    WmcCvProgram::Start(HostProgram);
+    Failures += HostCheck(WmcCvProgram::Done() == 0, "resume after clear");
+    WmcCvProgram::Stop();
+
+    wmcCv::SetProgEventSink(NULL);
+
+    return Failures;
+}
+
+/***********************************************************************************************************************
+ * Open the composite editor in cv mode on a cv number and let the decoder answer the reads.
+ */
+static void HostCompositeOpen(uint16_t CvNumber)
+{
+    cvEvent Event;
+    cvpulseSwitchEvent Turn;
+
+    wmcCv::Reset();
+    Event.EventData = startCv;
+    wmcCv::dispatch(Event);
+
+    Turn.EventData.Status = turn;
+    Turn.EventData.Delta  = 1;
+    for (uint16_t Number = 1; Number < CvNumber; Number++)
+    {
+        wmcCv::dispatch(Turn);
+    }
+
+    Turn.EventData.Status = pushedlong;
+    wmcCv::dispatch(Turn);
+    while (HostReply() == true)
+    {
+    }
+}
+
+/***********************************************************************************************************************
+ * Composite address editor: only the answer of the write in flight advances the batch and the editor returns to the cv
+ * it was opened on. Returns the number of failed checks.
+ */
+static int HostBatchTest(void)
+{
+    wmcCv::cvSnapshot Snapshot;
+    cvEvent Event;
+    cvpulseSwitchEvent Turn;
+    int Failures = 0;
+
+    HostTest = "batch write";
+    wmcCv::SetProgEventSink(HostSink);
+    HostDecoderNew(0);
+    HostDecoder[1]  = 3;
+    HostDecoder[29] = 0x06;
+
+    /* Opened on CV18, the decoder has short address 3. */
+    HostCompositeOpen(18);
+    Failures += HostCheck(wmcCv::StateId() == cvStateCvAddress, "address editor not opened");
+
+    Turn.EventData.Status = turn;
+    Turn.EventData.Delta  = 1;
+    wmcCv::dispatch(Turn);
+    Turn.EventData.Status = pushedNormal;
+    wmcCv::dispatch(Turn);
+    Failures
+        += HostCheck((wmcCv::StateId() == cvStateCvBatchWrite) && (HostRequest.CvNumber == 1), "CV1 not written");
+
+    /* A late answer of another cv and the answer of a POM read do not confirm the write of CV1. */
+    Event.EventData = cvData;
+    Event.cvNumber  = 29;
+    Event.cvValue   = 0x06;
+    wmcCv::dispatch(Event);
+    Event.EventData = responseReady;
+    Event.cvNumber  = 1;
+    Event.address   = 1234;
+    wmcCv::dispatch(Event);
+    Failures
+        += HostCheck((HostRequestPending == true) && (HostRequest.CvNumber == 1), "batch advanced by other answer");
+
+    while (HostReply() == true)
+    {
+    }
+
+    wmcCv::SnapshotSave(Snapshot);
+    Failures += HostCheck((HostDecoder[1] == 4) && (HostDecoder[29] == 0x06), "address not written");
+    Failures += HostCheck(
+        (wmcCv::StateId() == cvStateCvNumber) && (Snapshot.Session[cvSessionInteractive].CvNumber == 18),
+        "not back on the cv the editor was opened on");
+
+    wmcCv::SetProgEventSink(NULL);
+
+    return Failures;
+}
+
+/***********************************************************************************************************************
+ * Cv value constraints: limits, wrap around, read only cv's and CV29 with reserved bits set by the decoder. Returns the
+ * number of failed checks.
+ */
+static int HostConstraintTest(void)
+{
+    cvpulseSwitchEvent Turn;
+    int Failures = 0;
+
+    HostTest = "constraint";
+
+    Failures += HostCheck((wmcCv::CvValueValid(1, 0) == false) && (wmcCv::CvValueValid(1, 1) == true)
+            && (wmcCv::CvValueValid(1, 127) == true) && (wmcCv::CvValueValid(1, 128) == false),
+        "CV1 limits");
+    Failures += HostCheck((wmcCv::CvValueValid(29, 0x3F) == true) && (wmcCv::CvValueValid(29, 0x46) == false),
+        "CV29 reserved bits");
+    Failures += HostCheck((wmcCv::CvValueValid(7, 1) == false) && (wmcCv::CvValueConstrain(7, 5, 6) == 5),
+        "CV7 not read only");
+    Failures += HostCheck((wmcCv::CvValueValid(3, 255) == true) && (wmcCv::CvValueConstrain(3, 0, 255) == 255),
+        "cv without constraint limited");
+
+    /* Stepping past a limit from the limit wraps, a larger step stops at the limit. */
+    Failures += HostCheck((wmcCv::CvValueConstrain(1, 127, 128) == 1) && (wmcCv::CvValueConstrain(1, 1, 0) == 127),
+        "CV1 no wrap at limit");
+    Failures += HostCheck((wmcCv::CvValueConstrain(1, 120, 130) == 127) && (wmcCv::CvValueConstrain(1, 3, 0) == 1),
+        "CV1 larger step not stopped at limit");
+    Failures += HostCheck(wmcCv::CvValueConstrain(17, 231, 232) == 192, "CV17 no wrap at limit");
+
+    /* Decoder reports CV29 with bit 6 and 7 set, the address and flags batches are still written. */
+    wmcCv::SetProgEventSink(HostSink);
+    HostDecoderNew(0);
+    HostDecoder[1]  = 3;
+    HostDecoder[29] = 0xC6;
+
+    HostCompositeOpen(1);
+    Turn.EventData.Status = turn;
+    Turn.EventData.Delta  = 1;
+    wmcCv::dispatch(Turn);
+    Turn.EventData.Status = pushedNormal;
+    wmcCv::dispatch(Turn);
+    Failures += HostCheck(wmcCv::StateId() == cvStateCvBatchWrite, "address batch refused with CV29 0xC6");
+    while (HostReply() == true)
+    {
+    }
+    Failures += HostCheck((HostDecoder[1] == 4) && (HostDecoder[29] == 0x06), "address batch not written");
+
+    HostDecoder[29] = 0xC6;
+    HostCompositeOpen(29);
+    Failures += HostCheck(wmcCv::StateId() == cvStateCv29Flags, "flags editor not opened");
+    wmcCv::dispatch(Turn);
+    Failures += HostCheck(wmcCv::StateId() == cvStateCvBatchWrite, "flags batch refused with CV29 0xC6");
+    while (HostReply() == true)
+    {
+    }
+    Failures += HostCheck(HostDecoder[29] == 0x06, "reserved CV29 bits not cleared");
+
+    wmcCv::SetProgEventSink(NULL);
+
+    return Failures;
+}
+
+/***********************************************************************************************************************
+ * Count the transitions of the replay.
+ */
+static void HostReplayReport(cvTraceReplayResult const& Result)
+{
+    if (Result.StateBefore != Result.StateAfter)
+    {
+        HostTransitions++;
+    }
+}
+
+/***********************************************************************************************************************
+ * Trace round trip: record a cv read and write, export the records as text lines, read them back and replay them
+ * without divergences. Returns the number of failed checks.
+ */
+static int HostTraceTest(void)
+{
+    static cvTraceRecord Records[WMC_CV_TRACE_SIZE];
+    char Line[WMC_CV_TRACE_LINE_SIZE];
+    cvTraceRecord Record;
+    cvTraceReplaySummary Summary;
+    cvEvent Event;
+    cvpulseSwitchEvent Turn;
+    cvpushButtonEvent Button;
+    uint16_t Count;
+    int Failures = 0;
+
+    wmcCv::SetProgEventSink(HostSink);
+    wmcCv::Reset();
+    WmcCvTrace::Clear();
+    WmcCvTrace::Enable(true);
+
+    /* Read CV1, increase it and write it back. */
+    Event.EventData = startCv;
+    wmcCv::dispatch(Event);
+    Turn.EventData.Status = pushedNormal;
+    Turn.EventData.Delta  = 0;
+    wmcCv::dispatch(Turn);
+    Event.EventData = cvData;
+    Event.cvNumber  = 1;
+    Event.cvValue   = 3;
+    wmcCv::dispatch(Event);
+    Button.EventData.Button = button_0;
+    wmcCv::dispatch(Button);
+    Button.EventData.Button = button_5;
+    wmcCv::dispatch(Button);
+    Event.EventData = responseReady;
+    Event.cvValue   = 4;
+    wmcCv::dispatch(Event);
+    Button.EventData.Button = button_power;
+    wmcCv::dispatch(Button);
+
+    /* Export and import. */
+    for (Count = 0; WmcCvTrace::Format(Count, Line, sizeof(Line)) == true; Count++)
+    {
+        WmcCvTrace::Get(Count, Record);
+        if ((HostTraceParse(Line, Records[Count]) == false) || (Records[Count].TimeStamp != Record.TimeStamp)
+            || (Records[Count].Kind != Record.Kind) || (Records[Count].State != Record.State)
+            || (Records[Count].Data != Record.Data) || (Records[Count].Number != Record.Number)
+            || (Records[Count].Address != Record.Address) || (Records[Count].Value != Record.Value))
+        {
+            printf("trace: record %u changed by export\n", Count);
+            Failures++;
+        }
+    }
+
+    HostTransitions = 0;
+    if ((WmcCvTrace::Replay(Records, Count, HostReplayReport, Summary) == false) || (Summary.Replayed != 7)
+        || (HostTransitions != 6))
+    {
+        printf("trace: replay of %u records, %u events replayed, %u transitions, %u state and %u output divergences\n",
+            Count, Summary.Replayed, HostTransitions, Summary.Divergences, Summary.OutputDivergences);
+        Failures++;
+    }
+
+    wmcCv::SetProgEventSink(NULL);
+
+    return Failures;
+}
+
+/***********************************************************************************************************************
+ * Run the random event test for all seeds, the POM read against the simulated command station and the program runner
+ * and the trace round trip. Returns the number of failed checks.
+ */
+int main(void)
+{
+    cvSelfTestResult Result;
+    int Failures = 0;
+
+    for (uint32_t Seed = 1; Seed <= HOST_SEEDS; Seed++)
+    {
+        WmcCvSelfTest::Run(Seed, HOST_EVENTS, Result);
+
+        if ((Result.Failures > 0) || (Seed == 1))
+        {
+            printf("seed %u: %u events, %u failures (first at event %u, kind %u), %u events/s\n", Seed, Result.Events,
+                Result.Failures, Result.FirstFailure, Result.FirstFailureKind, Result.EventsPerSecond);
+        }
+
+        if (Result.Failures > 0)
+        {
+            Failures++;
+        }
+    }
+
+#if WMC_CV_POM_READ == 1
+    /* The loc answers after up to POM_READ_RETRIES lost requests. */
+    for (uint8_t Drops = 0; Drops <= 3; Drops++)
+    {
+        if (WmcCvSelfTest::PomRead(1234, 29, 0x26, Drops) == false)
+        {
+            printf("POM read with %u lost requests failed\n", Drops);
+            Failures++;
+        }
+    }
+
+    if (WmcCvSelfTest::PomRead(1234, 29, 0x26, 4) == true)
+    {
+        printf("POM read without answer accepted\n");
+        Failures++;
+    }
+#endif
+
+    Failures += HostProgramTest();
+    Failures += HostBatchTest();
+    Failures += HostConstraintTest();
+    Failures += HostTraceTest();
+
+    /* All outgoing events went to the self test, none to the other modules. */
+    if (HostSendCount != 0)
+    {
+        printf("%lu events send to the other modules\n", HostSendCount);
+        Failures++;
+    }
+
+    printf("%s\n", (Failures == 0) ? "PASSED" : "FAILED");
+
+    return Failures;
+}
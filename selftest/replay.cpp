@@ -0,0 +1,102 @@
+/***********************************************************************************************************************
+   @file   replay.cpp
+   @brief  Host replay of a cv module trace exported from the handset.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "host.h"
+#include <stdio.h>
+
+/***********************************************************************************************************************
+   D E F I N E S
+ **********************************************************************************************************************/
+
+/* Maximum number of records read from the exported trace. */
+#define REPLAY_RECORDS 4096
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+static cvTraceRecord ReplayRecords[REPLAY_RECORDS];
+
+static const char* const ReplayStateNames[] = { "Idle", "PomAddress", "CvNumber", "CvValueRead", "CvValueChange",
+    "CvWrite", "CvAddress", "Cv29Flags", "CvBatchWrite", "CvCompositeRead" };
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Name of a state.
+ */
+static const char* ReplayStateName(uint8_t State)
+{
+    if (State < sizeof(ReplayStateNames) / sizeof(ReplayStateNames[0]))
+    {
+        return ReplayStateNames[State];
+    }
+    return "?";
+}
+
+/***********************************************************************************************************************
+ * Print the transitions with the recorded time spent in the previous state, and every diverged event.
+ */
+static void ReplayReport(cvTraceReplayResult const& Result)
+{
+    bool Transition = (Result.StateBefore != Result.StateAfter);
+
+    if ((Transition == true) || (Result.Diverged == true) || (Result.OutputDiverged == true))
+    {
+        printf("%10lu ms %-15s -> %-15s after %6lu ms, dispatch %4lu us%s%s\n",
+            static_cast<unsigned long>(Result.Record->TimeStamp), ReplayStateName(Result.StateBefore),
+            ReplayStateName(Result.StateAfter), static_cast<unsigned long>(Result.TransitionTime),
+            static_cast<unsigned long>(Result.DispatchTime), (Result.Diverged == true) ? ", state diverged" : "",
+            (Result.OutputDiverged == true) ? ", output diverged" : "");
+    }
+}
+
+/***********************************************************************************************************************
+ * Replay the trace lines written by WmcCvTrace::Format, read from the file given or standard input. Other lines of
+ * the serial log are skipped. Returns 0 when the replay matches the trace.
+ */
+int main(int argc, char* argv[])
+{
+    char Line[256];
+    uint16_t Count = 0;
+    cvTraceReplaySummary Summary;
+    FILE* Input = stdin;
+
+    if (argc > 1)
+    {
+        Input = fopen(argv[1], "r");
+        if (Input == NULL)
+        {
+            printf("can not open %s\n", argv[1]);
+            return 2;
+        }
+    }
+
+    while ((Count < REPLAY_RECORDS) && (fgets(Line, sizeof(Line), Input) != NULL))
+    {
+        if (HostTraceParse(Line, ReplayRecords[Count]) == true)
+        {
+            Count++;
+        }
+    }
+
+    if (Input != stdin)
+    {
+        fclose(Input);
+    }
+
+    wmcCv::start();
+    bool Ok = WmcCvTrace::Replay(ReplayRecords, Count, ReplayReport, Summary);
+
+    printf("%u records, %u events replayed, %u state and %u output divergences\n", Count, Summary.Replayed,
+        Summary.Divergences, Summary.OutputDivergences);
+
+    return (Ok == true) ? 0 : 1;
+}
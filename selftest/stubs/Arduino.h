@@ -0,0 +1,16 @@
+/**
+ **********************************************************************************************************************
+ * @file  Arduino.h
+ * @brief Host stub of the Arduino core functions used by the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+unsigned long millis(void);
+unsigned long micros(void);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ **********************************************************************************************************************
+ * @file  WmcTft.h
+ * @brief Host stub of the display, only the functions used by the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef WMC_TFT_H
+#define WMC_TFT_H
+
+#include <stdint.h>
+
+class WmcTft
+{
+public:
+    enum color
+    {
+        color_green,
+        color_red,
+        color_yellow,
+        color_white,
+    };
+
+    void UpdateStatus(const char*, bool, color) {}
+    void ShowPomAddress(uint16_t, bool, color) {}
+    void ShowDccNumber(uint16_t, bool, bool) {}
+    void ShowDccValue(uint16_t, bool, bool) {}
+    void ShowDccValueRemove(bool) {}
+    void ShowDccNumberRemove(bool) {}
+    void UpdateRunningWheel(uint8_t) {}
+};
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ **********************************************************************************************************************
+ * @file  app_cfg.h
+ * @brief Host stub of the application configuration, APP_CFG_UC is set by the Makefile.
+ ***********************************************************************************************************************
+ */
+#ifndef APP_CFG_H
+#define APP_CFG_H
+
+#define APP_CFG_UC_ESP8266 0
+#define APP_CFG_UC_XMC 1
+
+#ifndef APP_CFG_UC
+#define APP_CFG_UC APP_CFG_UC_ESP8266
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+/**
+ **********************************************************************************************************************
+ * @file  pgmspace.h
+ * @brief Host stub of the ESP8266 flash access, flash data is read directly.
+ ***********************************************************************************************************************
+ */
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(Address) (*reinterpret_cast<const uint8_t*>(Address))
+#define pgm_read_word(Address) (*reinterpret_cast<const uint16_t*>(Address))
+
+#endif
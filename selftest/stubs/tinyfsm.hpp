@@ -0,0 +1,56 @@
+/**
+ **********************************************************************************************************************
+ * @file  tinyfsm.hpp
+ * @brief Host stub with the subset of tinyfsm used by the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef TINYFSM_HPP
+#define TINYFSM_HPP
+
+namespace tinyfsm
+{
+struct Event
+{
+};
+
+template <typename S> struct _state_instance
+{
+    static S value;
+};
+
+template <typename S> S _state_instance<S>::value;
+
+template <typename F> class Fsm
+{
+public:
+    using state_ptr_t = F*;
+
+    static state_ptr_t current_state_ptr;
+
+    static void set_initial_state(void);
+    static void start(void)
+    {
+        set_initial_state();
+        current_state_ptr->entry();
+    }
+    template <typename E> static void dispatch(E const& event) { current_state_ptr->react(event); }
+
+protected:
+    template <typename S> void transit(void)
+    {
+        current_state_ptr->exit();
+        current_state_ptr = &_state_instance<S>::value;
+        current_state_ptr->entry();
+    }
+};
+
+template <typename F> typename Fsm<F>::state_ptr_t Fsm<F>::current_state_ptr;
+}
+
+#define FSM_INITIAL_STATE(_FSM, _STATE)                                                                                \
+    namespace tinyfsm                                                                                                  \
+    {                                                                                                                  \
+    template <> void Fsm<_FSM>::set_initial_state(void) { current_state_ptr = &_state_instance<_STATE>::value; }       \
+    }
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ **********************************************************************************************************************
+ * @file  wmc_event.h
+ * @brief Host stub of the application events used by the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef WMC_EVENT_H
+#define WMC_EVENT_H
+
+#include <stdint.h>
+#include <tinyfsm.hpp>
+
+enum pulseSwitchStatus
+{
+    turn = 0,
+    pushturn,
+    pushedShort,
+    pushedNormal,
+    pushedlong,
+};
+
+struct pulseSwitchEvent
+{
+    pulseSwitchStatus Status;
+    int8_t Delta;
+};
+
+enum pushButtons
+{
+    button_none = 0,
+    button_0,
+    button_1,
+    button_2,
+    button_3,
+    button_4,
+    button_5,
+    button_power,
+};
+
+struct pushButtonsEvent
+{
+    pushButtons Button;
+};
+
+enum cvRequest
+{
+    cvRead = 0,
+    cvWrite,
+    cvStatusRequest,
+    pomWrite,
+    pomRead,
+    cvExit,
+    cvProgExit,
+};
+
+struct cvProgEvent : tinyfsm::Event
+{
+    cvRequest Request;
+    uint16_t Address;
+    uint16_t CvNumber;
+    uint8_t CvValue;
+};
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ **********************************************************************************************************************
+ * @file  xmc_event.h
+ * @brief Host stub of the application events of the XMC, same as the ESP8266 events.
+ ***********************************************************************************************************************
+ */
+#ifndef XMC_EVENT_H
+#define XMC_EVENT_H
+
+#include "wmc_event.h"
+
+#endif
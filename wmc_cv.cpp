@@ -8,11 +8,52 @@
  **********************************************************************************************************************/
 #include "wmc_cv.h"
 #include "fsmlist.hpp"
+#include "wmc_cv_trace.h"
+#include <stdio.h>
+#if APP_CFG_UC == APP_CFG_UC_ESP8266
+#include <pgmspace.h>
+#endif
 
 /***********************************************************************************************************************
    D E F I N E S
  **********************************************************************************************************************/
 
+/* Constant data is located in flash on the XMC and can be read directly. */
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(Address) (*reinterpret_cast<const uint8_t*>(Address))
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(Address) (*reinterpret_cast<const uint16_t*>(Address))
+#endif
+
+/* RAM budgets, all session data is in static members and states only contain the vtable pointer. make ram in
+   selftest reports the static RAM of this file per target. */
+static_assert(sizeof(cvSession) <= 8, "cvSession exceeds RAM budget");
+static_assert(sizeof(wmcCv) <= sizeof(void*), "States must not contain data members");
+
+/* Constraints of the NMRA cv's of a loc decoder in flash, sorted on cv number for the binary search. */
+static constexpr cvConstraint CvConstraintTable[] PROGMEM = {
+    { 1, 1, 127, 0x7F },    /* Short address, 0 is no loc address. */
+    { 7, 1, 0, 0x00 },      /* Version number, read only. */
+    { 8, 8, 8, 0xFF },      /* Manufacturer id, only the decoder reset value 8 can be written. */
+    { 17, 192, 231, 0xFF }, /* Long address high byte, 0xC0 added to address 1..10239 >> 8. */
+    { 29, 0, 63, 0x3F },    /* Configuration, bit 6 reserved and bit 7 set only for accessory decoders. */
+};
+
+static constexpr uint8_t CV_CONSTRAINT_COUNT = sizeof(CvConstraintTable) / sizeof(CvConstraintTable[0]);
+
+static constexpr bool CvConstraintSorted(uint8_t Index)
+{
+    return (Index + 1 >= CV_CONSTRAINT_COUNT)
+        || ((CvConstraintTable[Index].CvNumber < CvConstraintTable[Index + 1].CvNumber)
+               && CvConstraintSorted(Index + 1));
+}
+
+static_assert(CvConstraintSorted(0), "CvConstraintTable must be sorted on cv number");
+
 /***********************************************************************************************************************
    F O R W A R D  D E C L A R A T I O N S
  **********************************************************************************************************************/
@@ -22,6 +63,10 @@ class EnterCvNumber;
 class EnterCvValueRead;
 class EnterCvValueChange;
 class EnterCvWrite;
+class EnterCvAddress;
+class EnterCv29Flags;
+class EnterCvBatchWrite;
+class EnterCvCompositeRead;
 
 /***********************************************************************************************************************
    D A T A   D E C L A R A T I O N S (exported, local)
@@ -29,11 +74,31 @@ class EnterCvWrite;
 
 /* Init variables. */
 WmcTft wmcCv::m_wmcCvTft;
-uint16_t wmcCv::m_cvNumber    = CV_DEFAULT_NUMBER;
-uint16_t wmcCv::m_cvValue     = CV_DEFAULT_VALUE;
-uint16_t wmcCv::m_PomAddress  = POM_DEFAULT_ADDRESS;
-uint8_t wmcCv::m_timeOutCount = 0;
-bool wmcCv::m_PomActive       = false;
+cvProgEvent wmcCv::EventCvProg;
+cvSession wmcCv::m_Session[cvSessionMax] = {
+    { POM_DEFAULT_ADDRESS, false, CV_DEFAULT_NUMBER, CV_DEFAULT_VALUE, 0, 0 },
+    { POM_DEFAULT_ADDRESS, false, CV_DEFAULT_NUMBER, CV_DEFAULT_VALUE, 0, 0 },
+};
+cvSession& wmcCv::m_Ui              = wmcCv::m_Session[cvSessionInteractive];
+cvSession& wmcCv::m_Job             = wmcCv::m_Session[cvSessionBackground];
+uint8_t wmcCv::m_StateId            = cvStateIdle;
+uint8_t wmcCv::m_RequestId          = 0;
+uint8_t wmcCv::m_ProgTrackRequestId = 0;
+const cvJobStep* wmcCv::m_JobSteps  = NULL;
+uint16_t wmcCv::m_JobNumberOfSteps  = 0;
+uint16_t wmcCv::m_JobIndex          = 0;
+cvJobCallback wmcCv::m_JobCallback  = NULL;
+uint8_t wmcCv::m_JobHoldOff         = 0;
+uint16_t wmcCv::m_JobTicks          = 0;
+cvJobStep wmcCv::m_Batch[CV_BATCH_MAX];
+uint8_t wmcCv::m_BatchCount            = 0;
+uint8_t wmcCv::m_BatchIndex            = 0;
+uint16_t wmcCv::m_CompositeAddress     = POM_DEFAULT_ADDRESS;
+uint16_t wmcCv::m_CompositeCvNumber    = CV_DEFAULT_NUMBER;
+uint8_t wmcCv::m_CompositeTicks        = 0;
+uint8_t wmcCv::m_Cv29                  = CV29_DEFAULT;
+uint8_t wmcCv::m_PomReadRetry          = 0;
+cvProgEventSink wmcCv::m_ProgEventSink = NULL;
 
 /***********************************************************************************************************************
   F U N C T I O N S
@@ -46,27 +111,39 @@ class Idle : public wmcCv
 {
     /**
      */
-    void entry() override{ m_PomActive = false; };
+    void entry() override
+    {
+        m_StateId      = cvStateIdle;
+        m_Ui.PomActive = false;
+    };
 
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
         switch (e.EventData)
         {
         case startCv:
-            m_PomActive = false;
-            m_cvValue   = CV_DEFAULT_VALUE;
-            m_cvNumber  = CV_DEFAULT_NUMBER;
+            if (JobActive() == true)
+            {
+                /* Programming track in use by background job, only POM possible. Show how long it takes. */
+                UpdateProgress("TRACK BUSY", m_JobIndex, m_JobNumberOfSteps, m_JobTicks, m_JobIndex,
+                    WmcTft::color_red);
+                SendExit();
+                break;
+            }
+            m_Ui.PomActive = false;
+            m_Ui.CvValue   = CV_DEFAULT_VALUE;
+            m_Ui.CvNumber  = CV_DEFAULT_NUMBER;
             m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
             transit<EnterCvNumber>();
             break;
         case startPom:
-            m_PomActive  = true;
-            m_cvValue    = CV_DEFAULT_VALUE;
-            m_cvNumber   = CV_DEFAULT_NUMBER;
-            m_PomAddress = POM_DEFAULT_ADDRESS;
+            m_Ui.PomActive  = true;
+            m_Ui.CvValue    = CV_DEFAULT_VALUE;
+            m_Ui.CvNumber   = CV_DEFAULT_NUMBER;
+            m_Ui.PomAddress = POM_DEFAULT_ADDRESS;
             m_wmcCvTft.UpdateStatus("POM PROGRAMMING", true, WmcTft::color_green);
             transit<EnterPomAddress>();
             break;
@@ -87,12 +164,16 @@ class EnterPomAddress : public wmcCv
 {
     /**
      */
-    void entry() override { m_wmcCvTft.ShowPomAddress(m_PomAddress, true, WmcTft::color_green); };
+    void entry() override
+    {
+        m_StateId = cvStatePomAddress;
+        m_wmcCvTft.ShowPomAddress(m_Ui.PomAddress, true, WmcTft::color_green);
+    };
 
     /**
      * Handle forwarded pulse switch events.
      */
-    void react(cvpulseSwitchEvent const& e)
+    void handle(cvpulseSwitchEvent const& e) override
     {
         bool DataChanged = false;
 
@@ -101,61 +182,60 @@ class EnterPomAddress : public wmcCv
         case turn:
             if (e.EventData.Delta > 0)
             {
-                m_PomAddress++;
+                m_Ui.PomAddress++;
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_PomAddress > POM_DEFAULT_ADDRESS)
+                if (m_Ui.PomAddress > POM_DEFAULT_ADDRESS)
                 {
-                    m_PomAddress--;
+                    m_Ui.PomAddress--;
                     DataChanged = true;
                 }
                 else
                 {
-                    m_PomAddress = POM_MAX_ADDRESS;
-                    DataChanged  = true;
+                    m_Ui.PomAddress = POM_MAX_ADDRESS;
+                    DataChanged     = true;
                 }
             }
             break;
         case pushturn:
             if (e.EventData.Delta > 0)
             {
-                m_PomAddress += STEP_10;
+                m_Ui.PomAddress += STEP_10;
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_PomAddress > STEP_10)
+                if (m_Ui.PomAddress > STEP_10)
                 {
-                    m_PomAddress -= STEP_10;
+                    m_Ui.PomAddress -= STEP_10;
                     DataChanged = true;
                 }
                 else
                 {
-                    if (m_PomAddress > POM_DEFAULT_ADDRESS)
+                    if (m_Ui.PomAddress > POM_DEFAULT_ADDRESS)
                     {
-                        m_PomAddress -= STEP_1;
+                        m_Ui.PomAddress -= STEP_1;
                         DataChanged = true;
                     }
                     else
                     {
-                        m_PomAddress = POM_MAX_ADDRESS;
-                        DataChanged  = true;
+                        m_Ui.PomAddress = POM_MAX_ADDRESS;
+                        DataChanged     = true;
                     }
                 }
             }
             break;
         case pushedShort:
-            EventCvProg.Request = cvExit;
-            send_event(EventCvProg);
+            SendExit();
             transit<Idle>();
             break;
         case pushedNormal:
         case pushedlong:
-            if (m_PomAddress == POM_DEFAULT_ADDRESS)
+            if (m_Ui.PomAddress == POM_DEFAULT_ADDRESS)
             {
-                m_wmcCvTft.ShowPomAddress(m_PomAddress, false, WmcTft::color_red);
+                m_wmcCvTft.ShowPomAddress(m_Ui.PomAddress, false, WmcTft::color_red);
             }
             else
             {
@@ -166,50 +246,49 @@ class EnterPomAddress : public wmcCv
 
         if (DataChanged == true)
         {
-            if (m_PomAddress > POM_MAX_ADDRESS)
+            if (m_Ui.PomAddress > POM_MAX_ADDRESS)
             {
-                m_PomAddress = POM_DEFAULT_ADDRESS;
+                m_Ui.PomAddress = POM_DEFAULT_ADDRESS;
             }
-            m_wmcCvTft.ShowPomAddress(m_PomAddress, false, WmcTft::color_green);
+            m_wmcCvTft.ShowPomAddress(m_Ui.PomAddress, false, WmcTft::color_green);
         }
     }
 
     /**
      * Handle forwarded push button events to reset or increase the address.
      */
-    void react(cvpushButtonEvent const& e)
+    void handle(cvpushButtonEvent const& e) override
     {
         bool DataChanged = false;
 
         switch (e.EventData.Button)
         {
         case button_0:
-            m_PomAddress += STEP_1;
+            m_Ui.PomAddress += STEP_1;
             DataChanged = true;
             break;
         case button_1:
-            m_PomAddress += STEP_10;
+            m_Ui.PomAddress += STEP_10;
             DataChanged = true;
             break;
         case button_2:
-            m_PomAddress += STEP_100;
+            m_Ui.PomAddress += STEP_100;
             DataChanged = true;
             break;
         case button_3:
-            m_PomAddress += STEP_1000;
+            m_Ui.PomAddress += STEP_1000;
             DataChanged = true;
             break;
         case button_4:
-            m_PomAddress = POM_DEFAULT_ADDRESS;
-            DataChanged  = true;
+            m_Ui.PomAddress = POM_DEFAULT_ADDRESS;
+            DataChanged     = true;
             break;
         case button_5:
             transit<EnterCvNumber>();
             break;
             break;
         case button_power:
-            EventCvProg.Request = cvExit;
-            send_event(EventCvProg);
+            SendExit();
             transit<Idle>();
             break;
         case button_none: break;
@@ -217,18 +296,18 @@ class EnterPomAddress : public wmcCv
 
         if (DataChanged == true)
         {
-            if (m_PomAddress > POM_MAX_ADDRESS)
+            if (m_Ui.PomAddress > POM_MAX_ADDRESS)
             {
-                m_PomAddress = POM_MAX_ADDRESS;
+                m_Ui.PomAddress = POM_MAX_ADDRESS;
             }
-            m_wmcCvTft.ShowPomAddress(m_PomAddress, false, WmcTft::color_green);
+            m_wmcCvTft.ShowPomAddress(m_Ui.PomAddress, false, WmcTft::color_green);
         }
     }
 
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
         switch (e.EventData)
         {
@@ -253,13 +332,14 @@ class EnterCvNumber : public wmcCv
      */
     void entry() override
     {
-        m_wmcCvTft.ShowDccNumber(m_cvNumber, true, m_PomActive);
+        m_StateId = cvStateCvNumber;
+        m_wmcCvTft.ShowDccNumber(m_Ui.CvNumber, true, m_Ui.PomActive);
     };
 
     /**
      * Handle forwarded pulse switch events.
      */
-    void react(cvpulseSwitchEvent const& e)
+    void handle(cvpulseSwitchEvent const& e) override
     {
         bool DataChanged = false;
 
@@ -268,25 +348,25 @@ class EnterCvNumber : public wmcCv
         case turn:
             if (e.EventData.Delta > 0)
             {
-                m_cvNumber++;
+                m_Ui.CvNumber++;
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_cvNumber > CV_DEFAULT_NUMBER)
+                if (m_Ui.CvNumber > CV_DEFAULT_NUMBER)
                 {
-                    m_cvNumber--;
+                    m_Ui.CvNumber--;
                     DataChanged = true;
                 }
                 else
                 {
-                    if (m_PomActive == true)
+                    if (m_Ui.PomActive == true)
                     {
-                        m_cvNumber = CV_MAX_NUMBER;
+                        m_Ui.CvNumber = CV_MAX_NUMBER;
                     }
                     else
                     {
-                        m_cvNumber = CV_MAX_NUMBER_CV_MODE;
+                        m_Ui.CvNumber = CV_MAX_NUMBER_CV_MODE;
                     }
                     DataChanged = true;
                 }
@@ -295,32 +375,32 @@ class EnterCvNumber : public wmcCv
         case pushturn:
             if (e.EventData.Delta > 0)
             {
-                m_cvNumber += STEP_10;
+                m_Ui.CvNumber += STEP_10;
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_cvNumber > STEP_10)
+                if (m_Ui.CvNumber > STEP_10)
                 {
-                    m_cvNumber -= STEP_10;
+                    m_Ui.CvNumber -= STEP_10;
                     DataChanged = true;
                 }
                 else
                 {
-                    if (m_cvNumber > CV_DEFAULT_NUMBER)
+                    if (m_Ui.CvNumber > CV_DEFAULT_NUMBER)
                     {
-                        m_cvNumber -= STEP_1;
+                        m_Ui.CvNumber -= STEP_1;
                         DataChanged = true;
                     }
                     else
                     {
-                        if (m_PomActive == true)
+                        if (m_Ui.PomActive == true)
                         {
-                            m_cvNumber = CV_MAX_NUMBER;
+                            m_Ui.CvNumber = CV_MAX_NUMBER;
                         }
                         else
                         {
-                            m_cvNumber = CV_MAX_NUMBER_CV_MODE;
+                            m_Ui.CvNumber = CV_MAX_NUMBER_CV_MODE;
                         }
                         DataChanged = true;
                     }
@@ -328,22 +408,32 @@ class EnterCvNumber : public wmcCv
             }
             break;
         case pushedShort:
-            if (m_PomActive == false)
+            if (m_Ui.PomActive == false)
             {
-                EventCvProg.Request = cvExit;
-                send_event(EventCvProg);
+                SendExit();
                 transit<Idle>();
             }
             else
             {
                 /* Back to entering cv number. */
-                m_wmcCvTft.ShowDccNumberRemove(m_PomActive);
+                m_wmcCvTft.ShowDccNumberRemove(m_Ui.PomActive);
                 transit<EnterPomAddress>();
             }
             break;
-        case pushedNormal:
         case pushedlong:
-            if (m_PomActive == false)
+            /* Composite editors for the address and configuration cv's start from the values read from the decoder,
+               so only on the programming track. With POM the cv is changed on its own. */
+            if ((m_Ui.PomActive == false)
+                && ((m_Ui.CvNumber == CV_SHORT_ADDRESS) || (m_Ui.CvNumber == CV_LONG_ADDRESS_HIGH)
+                    || (m_Ui.CvNumber == CV_LONG_ADDRESS_LOW) || (m_Ui.CvNumber == CV_CONFIG)))
+            {
+                m_CompositeCvNumber = m_Ui.CvNumber;
+                transit<EnterCvCompositeRead>();
+                break;
+            }
+            /* Fall through */
+        case pushedNormal:
+            if (m_Ui.PomActive == false)
             {
                 transit<EnterCvValueRead>();
             }
@@ -356,49 +446,49 @@ class EnterCvNumber : public wmcCv
 
         if (DataChanged == true)
         {
-            if (m_PomActive == true)
+            if (m_Ui.PomActive == true)
             {
-                if (m_cvNumber > CV_MAX_NUMBER) m_cvNumber = CV_DEFAULT_NUMBER;
+                if (m_Ui.CvNumber > CV_MAX_NUMBER) m_Ui.CvNumber = CV_DEFAULT_NUMBER;
             }
-            else if (m_cvNumber > CV_MAX_NUMBER_CV_MODE)
+            else if (m_Ui.CvNumber > CV_MAX_NUMBER_CV_MODE)
             {
-                m_cvNumber = CV_DEFAULT_NUMBER;
+                m_Ui.CvNumber = CV_DEFAULT_NUMBER;
             }
-            m_wmcCvTft.ShowDccNumber(m_cvNumber, false, m_PomActive);
+            m_wmcCvTft.ShowDccNumber(m_Ui.CvNumber, false, m_Ui.PomActive);
         }
     }
 
     /**
      * Handle forwarded push button events.
      */
-    void react(cvpushButtonEvent const& e)
+    void handle(cvpushButtonEvent const& e) override
     {
         bool DataChanged = false;
 
         switch (e.EventData.Button)
         {
         case button_0:
-            m_cvNumber += STEP_1;
+            m_Ui.CvNumber += STEP_1;
             DataChanged = true;
             break;
         case button_1:
-            m_cvNumber += STEP_10;
+            m_Ui.CvNumber += STEP_10;
             DataChanged = true;
             break;
         case button_2:
-            m_cvNumber += STEP_100;
+            m_Ui.CvNumber += STEP_100;
             DataChanged = true;
             break;
         case button_3:
-            m_cvNumber += STEP_1000;
+            m_Ui.CvNumber += STEP_1000;
             DataChanged = true;
             break;
         case button_4:
-            m_cvNumber  = CV_DEFAULT_NUMBER;
-            DataChanged = true;
+            m_Ui.CvNumber = CV_DEFAULT_NUMBER;
+            DataChanged   = true;
             break;
         case button_5:
-            if (m_PomActive == false)
+            if (m_Ui.PomActive == false)
             {
                 transit<EnterCvValueRead>();
             }
@@ -408,8 +498,7 @@ class EnterCvNumber : public wmcCv
             }
             break;
         case button_power:
-            EventCvProg.Request = cvExit;
-            send_event(EventCvProg);
+            SendExit();
             transit<Idle>();
             break;
         case button_none: break;
@@ -417,22 +506,22 @@ class EnterCvNumber : public wmcCv
 
         if (DataChanged == true)
         {
-            if (m_PomActive == true)
+            if (m_Ui.PomActive == true)
             {
-                if (m_cvNumber > CV_MAX_NUMBER) m_cvNumber = CV_DEFAULT_NUMBER;
+                if (m_Ui.CvNumber > CV_MAX_NUMBER) m_Ui.CvNumber = CV_DEFAULT_NUMBER;
             }
-            else if (m_cvNumber > CV_MAX_NUMBER_CV_MODE)
+            else if (m_Ui.CvNumber > CV_MAX_NUMBER_CV_MODE)
             {
-                m_cvNumber = CV_DEFAULT_NUMBER;
+                m_Ui.CvNumber = CV_DEFAULT_NUMBER;
             }
-            m_wmcCvTft.ShowDccNumber(m_cvNumber, false, m_PomActive);
+            m_wmcCvTft.ShowDccNumber(m_Ui.CvNumber, false, m_Ui.PomActive);
         }
     }
 
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
         switch (e.EventData)
         {
@@ -449,7 +538,7 @@ class EnterCvNumber : public wmcCv
 };
 
 /***********************************************************************************************************************
- * Handle reading cv value
+ * Handle reading cv value, on the programming track or on the main track (POM read).
  */
 class EnterCvValueRead : public wmcCv
 {
@@ -458,38 +547,124 @@ class EnterCvValueRead : public wmcCv
      */
     void entry() override
     {
+        m_StateId = cvStateCvValueRead;
         m_wmcCvTft.UpdateStatus("READING CV", true, WmcTft::color_green);
-        EventCvProg.Request  = cvRead;
-        EventCvProg.CvNumber = m_cvNumber;
-        send_event(EventCvProg);
+        if (m_Ui.PomActive == false)
+        {
+            ClaimProgTrack(m_Ui);
+            SendCvProgEvent(cvRead, m_Ui);
+        }
+#if WMC_CV_POM_READ == 1
+        else
+        {
+            m_PomReadRetry = 0;
+            SendCvProgEvent(pomRead, m_Ui);
+        }
+#endif
 
-        m_timeOutCount = 0;
-        m_wmcCvTft.UpdateRunningWheel(m_timeOutCount);
+        m_Ui.TimeOutCount = 0;
+        m_wmcCvTft.UpdateRunningWheel(m_Ui.TimeOutCount);
     };
 
+    /**
+     */
+    void exit() override { ReleaseProgTrack(m_Ui); };
+
+#if WMC_CV_POM_READ == 1
+    /**
+     * Repeat the POM read, the loc may have missed the request or its answer was not received.
+     */
+    void PomReadRetry(void)
+    {
+        if (m_PomReadRetry < POM_READ_RETRIES)
+        {
+            m_PomReadRetry++;
+            m_Ui.TimeOutCount = 0;
+            SendCvProgEvent(pomRead, m_Ui);
+        }
+        else
+        {
+            m_wmcCvTft.UpdateStatus("NO POM RESPONSE", true, WmcTft::color_red);
+            transit<EnterCvValueChange>();
+        }
+    }
+
+    /**
+     * Handle cv command events of a POM read.
+     */
+    void HandlePomRead(cvEvent const& e)
+    {
+        switch (e.EventData)
+        {
+        case startCv:
+        case startPom:
+        case responseBusy:
+        case responseNok:
+        case responseReady: break;
+        case cvNack:
+            if ((e.address == m_Ui.PomAddress) && (e.cvNumber == m_Ui.CvNumber))
+            {
+                PomReadRetry();
+            }
+            break;
+        case cvData:
+            /* Only accept the answer of the requested loc and cv. */
+            if ((e.address == m_Ui.PomAddress) && (e.cvNumber == m_Ui.CvNumber))
+            {
+                m_Ui.CvValue = e.cvValue;
+                m_wmcCvTft.UpdateStatus("POM PROGRAMMING", true, WmcTft::color_green);
+                transit<EnterCvValueChange>();
+            }
+            break;
+        case update:
+            m_Ui.TimeOutCount++;
+            UpdateWaiting(m_Ui);
+
+            if (m_Ui.TimeOutCount > TIME_OUT_2_SEC)
+            {
+                PomReadRetry();
+            }
+            break;
+        }
+    }
+#endif
+
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
+#if WMC_CV_POM_READ == 1
+        if (m_Ui.PomActive == true)
+        {
+            HandlePomRead(e);
+            return;
+        }
+#endif
+
+        /* Answers of POM reads are not for the programming track. */
+        if (e.address != 0)
+        {
+            return;
+        }
+
         switch (e.EventData)
         {
         case startCv:
         case startPom: break;
         case cvNack: transit<EnterCvValueChange>(); break;
         case cvData:
-            m_cvValue = e.cvValue;
+            m_Ui.CvValue = e.cvValue;
             transit<EnterCvValueChange>();
             break;
         case update:
-            m_timeOutCount++;
-            m_wmcCvTft.UpdateRunningWheel(m_timeOutCount);
+            m_Ui.TimeOutCount++;
+            UpdateWaiting(m_Ui);
 
-            EventCvProg.Request = cvStatusRequest;
-            send_event(EventCvProg);
+            SendCvProgEvent(cvStatusRequest, m_Ui);
 
             /* If after 20 seconds still no response continue.... */
-            if (m_timeOutCount > TIME_OUT_20_SEC)
+            if (m_Ui.TimeOutCount > TIME_OUT_20_SEC)
             {
                 transit<EnterCvValueChange>();
             }
@@ -497,7 +672,7 @@ class EnterCvValueRead : public wmcCv
         case responseBusy: break;
         case responseNok: transit<EnterCvValueChange>(); break;
         case responseReady:
-            m_cvValue = e.cvValue;
+            m_Ui.CvValue = e.cvValue;
             transit<EnterCvValueChange>();
             break;
             break;
@@ -514,122 +689,157 @@ class EnterCvValueChange : public wmcCv
      */
     void entry() override
     {
-        if (m_PomActive == false)
+        m_StateId = cvStateCvValueChange;
+        if (m_Ui.PomActive == false)
         {
             m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
         }
-        m_wmcCvTft.ShowDccValue(m_cvValue, true, m_PomActive);
+        m_wmcCvTft.ShowDccValue(m_Ui.CvValue, true, m_Ui.PomActive);
     };
 
+    /**
+     * Increase the cv value, restart at the default value when passing the maximum value.
+     */
+    void CvValueIncrease(uint8_t Step)
+    {
+        if (m_Ui.CvValue > (CV_MAX_VALUE - Step))
+        {
+            m_Ui.CvValue = CV_DEFAULT_VALUE;
+        }
+        else
+        {
+            m_Ui.CvValue += Step;
+        }
+    }
+
+    /**
+     * Write the value, a value outside the constraint of the cv is refused and not send.
+     */
+    void Write(void)
+    {
+        if (CvValueValid(m_Ui.CvNumber, m_Ui.CvValue) == true)
+        {
+            transit<EnterCvWrite>();
+        }
+        else
+        {
+            m_wmcCvTft.UpdateStatus("INVALID VALUE", true, WmcTft::color_red);
+        }
+    }
+
     /**
      * Handle forwarded pulse switch events.
      */
-    void react(cvpulseSwitchEvent const& e)
+    void handle(cvpulseSwitchEvent const& e) override
     {
         bool DataChanged = false;
+        uint8_t Previous = m_Ui.CvValue;
 
         switch (e.EventData.Status)
         {
         case turn:
             if (e.EventData.Delta > 0)
             {
-                m_cvValue++;
+                CvValueIncrease(STEP_1);
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_cvValue > CV_DEFAULT_VALUE)
+                if (m_Ui.CvValue > CV_DEFAULT_VALUE)
                 {
-                    m_cvValue--;
+                    m_Ui.CvValue--;
                     DataChanged = true;
                 }
                 else
                 {
-                    m_cvValue   = CV_MAX_VALUE;
-                    DataChanged = true;
+                    m_Ui.CvValue = CV_MAX_VALUE;
+                    DataChanged  = true;
                 }
             }
             break;
         case pushturn:
             if (e.EventData.Delta > 0)
             {
-                m_cvValue += STEP_10;
+                CvValueIncrease(STEP_10);
                 DataChanged = true;
             }
             else if (e.EventData.Delta < 0)
             {
-                if (m_cvValue > STEP_10)
+                if (m_Ui.CvValue > STEP_10)
                 {
-                    m_cvValue -= STEP_10;
+                    m_Ui.CvValue -= STEP_10;
                     DataChanged = true;
                 }
                 else
                 {
-                    if (m_cvValue > CV_DEFAULT_VALUE)
+                    if (m_Ui.CvValue > CV_DEFAULT_VALUE)
                     {
-                        m_cvValue -= STEP_1;
+                        m_Ui.CvValue -= STEP_1;
                         DataChanged = true;
                     }
                     else
                     {
-                        m_cvValue   = CV_MAX_VALUE;
-                        DataChanged = true;
+                        m_Ui.CvValue = CV_MAX_VALUE;
+                        DataChanged  = true;
                     }
                 }
             }
             break;
         case pushedShort:
             /* Back to entering cv number. */
-            m_wmcCvTft.ShowDccValueRemove(m_PomActive);
+            m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
             transit<EnterCvNumber>();
             break;
         case pushedNormal:
-        case pushedlong: transit<EnterCvWrite>(); break;
+        case pushedlong: Write(); break;
         }
 
         if (DataChanged == true)
         {
-            if (m_cvValue > CV_MAX_VALUE)
-            {
-                m_cvValue = CV_DEFAULT_VALUE;
-            }
-            m_wmcCvTft.ShowDccValue(m_cvValue, false, m_PomActive);
+            m_Ui.CvValue = CvValueConstrain(m_Ui.CvNumber, Previous, m_Ui.CvValue);
+            m_wmcCvTft.ShowDccValue(m_Ui.CvValue, false, m_Ui.PomActive);
         }
     }
 
     /**
      * Handle forwarded push button events.
      */
-    void react(cvpushButtonEvent const& e)
+    void handle(cvpushButtonEvent const& e) override
     {
         bool DataChanged = false;
+        uint8_t Previous = m_Ui.CvValue;
 
         switch (e.EventData.Button)
         {
         case button_0:
-            m_cvValue += STEP_1;
+            CvValueIncrease(STEP_1);
             DataChanged = true;
             break;
         case button_1:
-            m_cvValue += STEP_10;
+            CvValueIncrease(STEP_10);
             DataChanged = true;
             break;
         case button_2:
-            m_cvValue += STEP_100;
+            CvValueIncrease(STEP_100);
             DataChanged = true;
             break;
-        case button_3: break;
+        case button_3:
+            /* Read the value from the decoder, on the main track when POM programming. */
+            if ((m_Ui.PomActive == false) || (WMC_CV_POM_READ == 1))
+            {
+                transit<EnterCvValueRead>();
+            }
+            break;
         case button_4:
-            m_cvValue   = STEP_1;
-            DataChanged = true;
+            m_Ui.CvValue = STEP_1;
+            DataChanged  = true;
             break;
         case button_5:
-            transit<EnterCvWrite>();
+            Write();
             break;
             break;
         case button_power:
-            EventCvProg.Request = cvExit;
-            send_event(EventCvProg);
+            SendExit();
             transit<Idle>();
             break;
         case button_none: break;
@@ -637,18 +847,15 @@ class EnterCvValueChange : public wmcCv
 
         if (DataChanged == true)
         {
-            if (m_cvValue > CV_MAX_VALUE)
-            {
-                m_cvValue = CV_DEFAULT_VALUE;
-            }
-            m_wmcCvTft.ShowDccValue(m_cvValue, false, m_PomActive);
+            m_Ui.CvValue = CvValueConstrain(m_Ui.CvNumber, Previous, m_Ui.CvValue);
+            m_wmcCvTft.ShowDccValue(m_Ui.CvValue, false, m_Ui.PomActive);
         }
     }
 
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
         switch (e.EventData)
         {
@@ -674,42 +881,37 @@ class EnterCvWrite : public wmcCv
      */
     void entry() override
     {
-        if (m_PomActive == false)
+        m_StateId = cvStateCvWrite;
+        if (m_Ui.PomActive == false)
         {
-            EventCvProg.Request = cvWrite;
             m_wmcCvTft.UpdateStatus("WRITING CV", true, WmcTft::color_green);
-        }
-        else
-        {
-            EventCvProg.Request = pomWrite;
-        }
-
-        /* Fill the CV data, */
-        EventCvProg.Address  = m_PomAddress;
-        EventCvProg.CvNumber = m_cvNumber;
-        EventCvProg.CvValue  = m_cvValue;
 
-        if (m_PomActive == false)
-        {
             /* Wait for response when CV programming. */
-            m_timeOutCount = 0;
-            m_wmcCvTft.UpdateRunningWheel(m_timeOutCount);
+            ClaimProgTrack(m_Ui);
+            m_Ui.TimeOutCount = 0;
+            m_wmcCvTft.UpdateRunningWheel(m_Ui.TimeOutCount);
+            SendCvProgEvent(cvWrite, m_Ui);
         }
         else
         {
+            SendCvProgEvent(pomWrite, m_Ui);
+            m_wmcCvTft.UpdateStatus("POM PROGRAMMING", true, WmcTft::color_green);
+
             /* No response from Z21 when POM programming, so back to entering address. */
-            m_wmcCvTft.ShowDccValueRemove(m_PomActive);
-            m_wmcCvTft.ShowDccNumberRemove(m_PomActive);
+            m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
+            m_wmcCvTft.ShowDccNumberRemove(m_Ui.PomActive);
             transit<EnterPomAddress>();
         }
-
-        send_event(EventCvProg);
     }
 
+    /**
+     */
+    void exit() override { ReleaseProgTrack(m_Ui); };
+
     /**
      * Handle cv command events.
      */
-    void react(cvEvent const& e) override
+    void handle(cvEvent const& e) override
     {
         switch (e.EventData)
         {
@@ -721,19 +923,19 @@ class EnterCvWrite : public wmcCv
         case responseNok:
         case responseReady:
             /* Programming ok, back to entering cv number for next CV. */
-            if (m_PomActive == false)
+            if (m_Ui.PomActive == false)
             {
-                m_wmcCvTft.ShowDccValueRemove(m_PomActive);
+                m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
                 m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
                 transit<EnterCvNumber>();
             }
             break;
         case update:
-            m_timeOutCount++;
-            m_wmcCvTft.UpdateRunningWheel(m_timeOutCount);
+            m_Ui.TimeOutCount++;
+            UpdateWaiting(m_Ui);
 
             /* If after 10 seconds still no response, keep screen to retry writing.... */
-            if (m_timeOutCount > TIME_OUT_10_SEC)
+            if (m_Ui.TimeOutCount > TIME_OUT_10_SEC)
             {
                 transit<EnterCvValueChange>();
             }
@@ -742,13 +944,1132 @@ class EnterCvWrite : public wmcCv
     }
 };
 
+/***********************************************************************************************************************
+ * Enter a loc address and write it as short (CV1) or long (CV17/CV18) address including CV29 in one batch.
+ */
+class EnterCvAddress : public wmcCv
+{
+    /**
+     */
+    void entry() override
+    {
+        m_StateId = cvStateCvAddress;
+        m_wmcCvTft.UpdateStatus("LOC ADDRESS", true, WmcTft::color_green);
+        m_wmcCvTft.ShowDccValue(m_CompositeAddress, true, m_Ui.PomActive);
+    };
+
+    /**
+     * Change the address, wrap around at the limits.
+     */
+    void AddressChange(int16_t Delta)
+    {
+        int16_t Address = static_cast<int16_t>(m_CompositeAddress) + Delta;
+
+        if (Address > static_cast<int16_t>(POM_MAX_ADDRESS))
+        {
+            Address = POM_DEFAULT_ADDRESS;
+        }
+        else if (Address < static_cast<int16_t>(POM_DEFAULT_ADDRESS))
+        {
+            Address = POM_MAX_ADDRESS;
+        }
+
+        m_CompositeAddress = static_cast<uint16_t>(Address);
+        m_wmcCvTft.ShowDccValue(m_CompositeAddress, false, m_Ui.PomActive);
+    }
+
+    /**
+     * Leave the editor and continue with the cv number.
+     */
+    void Back(void)
+    {
+        m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
+        m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
+        transit<EnterCvNumber>();
+    }
+
+    /**
+     * Handle forwarded pulse switch events.
+     */
+    void handle(cvpulseSwitchEvent const& e) override
+    {
+        switch (e.EventData.Status)
+        {
+        case turn:
+            if (e.EventData.Delta > 0)
+            {
+                AddressChange(STEP_1);
+            }
+            else if (e.EventData.Delta < 0)
+            {
+                AddressChange(-STEP_1);
+            }
+            break;
+        case pushturn:
+            if (e.EventData.Delta > 0)
+            {
+                AddressChange(STEP_10);
+            }
+            else if (e.EventData.Delta < 0)
+            {
+                AddressChange(-STEP_10);
+            }
+            break;
+        case pushedShort: Back(); break;
+        case pushedNormal:
+        case pushedlong:
+            if (BatchAddress(m_CompositeAddress) == true)
+            {
+                transit<EnterCvBatchWrite>();
+            }
+            else
+            {
+                m_wmcCvTft.UpdateStatus("INVALID VALUE", true, WmcTft::color_red);
+            }
+            break;
+        }
+    }
+
+    /**
+     * Handle forwarded push button events.
+     */
+    void handle(cvpushButtonEvent const& e) override
+    {
+        switch (e.EventData.Button)
+        {
+        case button_0: AddressChange(STEP_1); break;
+        case button_1: AddressChange(STEP_10); break;
+        case button_2: AddressChange(STEP_100); break;
+        case button_3: AddressChange(STEP_1000); break;
+        case button_4:
+            m_CompositeAddress = POM_DEFAULT_ADDRESS;
+            m_wmcCvTft.ShowDccValue(m_CompositeAddress, false, m_Ui.PomActive);
+            break;
+        case button_5:
+            if (BatchAddress(m_CompositeAddress) == true)
+            {
+                transit<EnterCvBatchWrite>();
+            }
+            else
+            {
+                m_wmcCvTft.UpdateStatus("INVALID VALUE", true, WmcTft::color_red);
+            }
+            break;
+        case button_power:
+            SendExit();
+            transit<Idle>();
+            break;
+        case button_none: break;
+        }
+    }
+};
+
+/***********************************************************************************************************************
+ * Change the CV29 configuration flags, buttons 0..5 toggle bit 0..5.
+ */
+class EnterCv29Flags : public wmcCv
+{
+    /**
+     */
+    void entry() override
+    {
+        m_StateId = cvStateCv29Flags;
+        m_wmcCvTft.UpdateStatus("CV29 FLAGS", true, WmcTft::color_green);
+        m_wmcCvTft.ShowDccValue(m_Cv29, true, m_Ui.PomActive);
+    };
+
+    /**
+     * Handle forwarded pulse switch events.
+     */
+    void handle(cvpulseSwitchEvent const& e) override
+    {
+        switch (e.EventData.Status)
+        {
+        case turn:
+        case pushturn: break;
+        case pushedShort:
+            m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
+            m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
+            transit<EnterCvNumber>();
+            break;
+        case pushedNormal:
+        case pushedlong:
+            BatchClear();
+            if (BatchAdd(CV_CONFIG, m_Cv29) == true)
+            {
+                transit<EnterCvBatchWrite>();
+            }
+            else
+            {
+                m_wmcCvTft.UpdateStatus("INVALID VALUE", true, WmcTft::color_red);
+            }
+            break;
+        }
+    }
+
+    /**
+     * Handle forwarded push button events.
+     */
+    void handle(cvpushButtonEvent const& e) override
+    {
+        uint8_t Bit = 0;
+
+        switch (e.EventData.Button)
+        {
+        case button_0: Bit = 0x01; break;
+        case button_1: Bit = 0x02; break;
+        case button_2: Bit = 0x04; break;
+        case button_3: Bit = 0x08; break;
+        case button_4: Bit = 0x10; break;
+        case button_5: Bit = CV29_LONG_ADDRESS; break;
+        case button_power:
+            SendExit();
+            transit<Idle>();
+            break;
+        case button_none: break;
+        }
+
+        if (Bit != 0)
+        {
+            m_Cv29 ^= Bit;
+            m_wmcCvTft.ShowDccValue(m_Cv29, false, m_Ui.PomActive);
+        }
+    }
+};
+
+/***********************************************************************************************************************
+ * Write all cv's of the batch on the programming track. Each write is send as soon as the previous one is confirmed, so
+ * the whole batch needs a single wait.
+ */
+class EnterCvBatchWrite : public wmcCv
+{
+    /**
+     */
+    void entry() override
+    {
+        m_StateId         = cvStateCvBatchWrite;
+        m_BatchIndex      = 0;
+        m_Ui.TimeOutCount = 0;
+        SendNext();
+        m_wmcCvTft.UpdateRunningWheel(m_Ui.TimeOutCount);
+    }
+
+    /**
+     */
+    void exit() override { ReleaseProgTrack(m_Ui); };
+
+    /**
+     * Send the next write of the batch.
+     */
+    void SendNext(void)
+    {
+        m_Ui.CvNumber = m_Batch[m_BatchIndex].CvNumber;
+        m_Ui.CvValue  = m_Batch[m_BatchIndex].CvValue;
+        m_BatchIndex++;
+
+        /* Status line only redrawn when a cv is done. */
+        UpdateProgress("WRITING CV", m_BatchIndex - 1, m_BatchCount, m_Ui.TimeOutCount, m_BatchIndex - 1,
+            WmcTft::color_green);
+        ClaimProgTrack(m_Ui);
+        SendCvProgEvent(cvWrite, m_Ui);
+    }
+
+    /**
+     * Write in flight confirmed, continue with the next cv of the batch.
+     */
+    void Written(void)
+    {
+        if (m_BatchIndex < m_BatchCount)
+        {
+            SendNext();
+        }
+        else
+        {
+            Done(true);
+        }
+    }
+
+    /**
+     * Batch finished or aborted, back to entering cv number on the cv the composite editor was opened on.
+     */
+    void Done(bool Ok)
+    {
+        m_Ui.CvNumber = m_CompositeCvNumber;
+        m_wmcCvTft.ShowDccValueRemove(m_Ui.PomActive);
+        if (Ok == true)
+        {
+            m_wmcCvTft.UpdateStatus("CV PROGRAMMING", true, WmcTft::color_green);
+        }
+        else
+        {
+            m_wmcCvTft.UpdateStatus("WRITING CV FAILED", true, WmcTft::color_red);
+        }
+        transit<EnterCvNumber>();
+    }
+
+    /**
+     * Handle cv command events.
+     */
+    void handle(cvEvent const& e) override
+    {
+        /* Answers of POM reads are not for the programming track. */
+        if (e.address != 0)
+        {
+            return;
+        }
+
+        switch (e.EventData)
+        {
+        case startCv:
+        case startPom:
+        case responseBusy: break;
+        case cvData:
+            /* A late answer of another cv does not confirm the write in flight. */
+            if (e.cvNumber == m_Ui.CvNumber)
+            {
+                Written();
+            }
+            break;
+        case responseReady: Written(); break;
+        case cvNack:
+        case responseNok:
+            /* Do not write the remaining cv's, the decoder would be left with a mix of old and new values. */
+            Done(false);
+            break;
+        case update:
+            m_Ui.TimeOutCount++;
+            UpdateWaiting(m_Ui);
+
+            /* One timeout for the whole batch. */
+            if (m_Ui.TimeOutCount > TIME_OUT_20_SEC)
+            {
+                Done(false);
+            }
+            break;
+        }
+    }
+};
+
+/***********************************************************************************************************************
+ * Read CV29 and the loc address from the decoder on the programming track before opening a composite editor, so the
+ * batch written by the editor keeps the other CV29 bits of the decoder. CV17/CV18 are read when CV29 selects the long
+ * address, CV1 otherwise.
+ */
+class EnterCvCompositeRead : public wmcCv
+{
+    /**
+     */
+    void entry() override
+    {
+        m_StateId        = cvStateCvCompositeRead;
+        m_CompositeTicks = 0;
+        m_wmcCvTft.UpdateStatus("READING CV", true, WmcTft::color_green);
+        Read(CV_CONFIG, 0, 0);
+    };
+
+    /**
+     */
+    void exit() override { ReleaseProgTrack(m_Ui); };
+
+    /**
+     * Send the read request of a cv. The number of cv's to read is known once CV29 is read, from then on the progress
+     * is shown when a cv is done.
+     */
+    void Read(uint16_t CvNumber, uint8_t Done, uint8_t Total)
+    {
+        if (Done > 0)
+        {
+            UpdateProgress("READING CV", Done, Total, m_CompositeTicks, Done, WmcTft::color_green);
+        }
+
+        m_Ui.CvNumber     = CvNumber;
+        m_Ui.TimeOutCount = 0;
+        ClaimProgTrack(m_Ui);
+        SendCvProgEvent(cvRead, m_Ui);
+        m_wmcCvTft.UpdateRunningWheel(m_Ui.TimeOutCount);
+    }
+
+    /**
+     * Store the read value and continue with the next cv or open the editor.
+     */
+    void Value(uint8_t CvValue)
+    {
+        cvConstraint Constraint;
+
+        ReleaseProgTrack(m_Ui);
+        m_CompositeTicks = static_cast<uint8_t>(m_CompositeTicks + m_Ui.TimeOutCount);
+
+        switch (m_Ui.CvNumber)
+        {
+        case CV_CONFIG:
+            /* Reserved bits reported by the decoder are cleared, with them set the constraint would refuse every batch
+               with CV29 and the flags editor can not toggle them. */
+            m_Cv29 = CvValue;
+            if (CvConstraintFind(CV_CONFIG, Constraint) == true)
+            {
+                m_Cv29 &= Constraint.Mask;
+            }
+
+            if (m_CompositeCvNumber == CV_CONFIG)
+            {
+                m_Ui.CvNumber = m_CompositeCvNumber;
+                transit<EnterCv29Flags>();
+            }
+            else if ((m_Cv29 & CV29_LONG_ADDRESS) != 0)
+            {
+                Read(CV_LONG_ADDRESS_HIGH, 1, 3);
+            }
+            else
+            {
+                Read(CV_SHORT_ADDRESS, 1, 2);
+            }
+            break;
+        case CV_LONG_ADDRESS_HIGH:
+            m_CompositeAddress = static_cast<uint16_t>((CvValue & ~LONG_ADDRESS_HIGH_BASE) << 8);
+            Read(CV_LONG_ADDRESS_LOW, 2, 3);
+            break;
+        case CV_LONG_ADDRESS_LOW:
+            m_CompositeAddress |= CvValue;
+            Edit();
+            break;
+        default:
+            m_CompositeAddress = CvValue;
+            Edit();
+            break;
+        }
+    }
+
+    /**
+     * Open the address editor, an address out of range starts at the default address.
+     */
+    void Edit(void)
+    {
+        if ((m_CompositeAddress < POM_DEFAULT_ADDRESS) || (m_CompositeAddress > POM_MAX_ADDRESS))
+        {
+            m_CompositeAddress = POM_DEFAULT_ADDRESS;
+        }
+        m_Ui.CvNumber = m_CompositeCvNumber;
+        transit<EnterCvAddress>();
+    }
+
+    /**
+     * Reading failed, without the decoder values the editor can not be opened.
+     */
+    void Failed(void)
+    {
+        m_Ui.CvNumber = m_CompositeCvNumber;
+        m_wmcCvTft.UpdateStatus("READING CV FAILED", true, WmcTft::color_red);
+        transit<EnterCvNumber>();
+    }
+
+    /**
+     * Handle cv command events.
+     */
+    void handle(cvEvent const& e) override
+    {
+        /* Answers of POM reads are not for the programming track. */
+        if (e.address != 0)
+        {
+            return;
+        }
+
+        switch (e.EventData)
+        {
+        case startCv:
+        case startPom:
+        case responseBusy: break;
+        case cvNack:
+        case responseNok: Failed(); break;
+        case cvData:
+            /* A late answer of the previous cv is ignored. */
+            if (e.cvNumber == m_Ui.CvNumber)
+            {
+                Value(e.cvValue);
+            }
+            break;
+        case responseReady: Value(e.cvValue); break;
+        case update:
+            m_Ui.TimeOutCount++;
+            UpdateWaiting(m_Ui);
+
+            SendCvProgEvent(cvStatusRequest, m_Ui);
+
+            if (m_Ui.TimeOutCount > TIME_OUT_20_SEC)
+            {
+                Failed();
+            }
+            break;
+        }
+    }
+
+    /**
+     * Handle forwarded push button events.
+     */
+    void handle(cvpushButtonEvent const& e) override
+    {
+        if (e.EventData.Button == button_power)
+        {
+            SendExit();
+            transit<Idle>();
+        }
+    }
+};
+
+/***********************************************************************************************************************
+ * Event entry points, record the event in the trace and forward it to the active state.
+ */
+void wmcCv::react(cvEvent const& e)
+{
+    WmcCvTrace::Record(cvTraceCv, m_StateId, e.EventData, e.cvNumber, e.address, e.cvValue);
+
+    /* Responses on requests of the background job are not forwarded to the interactive session. */
+    if (JobHandle(e) == false)
+    {
+        handle(e);
+    }
+}
+
+void wmcCv::react(cvpushButtonEvent const& e)
+{
+    WmcCvTrace::Record(cvTracePushButton, m_StateId, e.EventData.Button, 0, 0, 0);
+    handle(e);
+}
+
+void wmcCv::react(cvpulseSwitchEvent const& e)
+{
+    WmcCvTrace::Record(
+        cvTracePulseSwitch, m_StateId, e.EventData.Status, static_cast<uint16_t>(e.EventData.Delta), 0, 0);
+    handle(e);
+}
+
+/***********************************************************************************************************************
+ * Build the cv module event in place from the session data, record it and send it to other module or the sink. The
+ * address is 0 for the programming track, so the event does not depend on the address of an earlier POM session.
+ */
+void wmcCv::SendCvProgEvent(cvProgRequest Request, cvSession const& Session)
+{
+    EventCvProg.Request  = Request;
+    EventCvProg.Address  = (Session.PomActive == true) ? Session.PomAddress : 0;
+    EventCvProg.CvNumber = Session.CvNumber;
+    EventCvProg.CvValue  = Session.CvValue;
+
+    WmcCvTrace::Record(
+        cvTraceProg, m_StateId, EventCvProg.Request, EventCvProg.CvNumber, EventCvProg.Address, EventCvProg.CvValue);
+
+    if (m_ProgEventSink != NULL)
+    {
+        m_ProgEventSink(EventCvProg);
+    }
+    else
+    {
+        send_event(EventCvProg);
+    }
+}
+
+/***********************************************************************************************************************
+ * Set all module data to the initial values and start in Idle. The sink is kept.
+ */
+void wmcCv::Reset(void)
+{
+    for (uint8_t Index = 0; Index < cvSessionMax; Index++)
+    {
+        m_Session[Index].PomAddress   = POM_DEFAULT_ADDRESS;
+        m_Session[Index].PomActive    = false;
+        m_Session[Index].CvNumber     = CV_DEFAULT_NUMBER;
+        m_Session[Index].CvValue      = CV_DEFAULT_VALUE;
+        m_Session[Index].TimeOutCount = 0;
+        m_Session[Index].RequestId    = 0;
+    }
+
+    m_RequestId          = 0;
+    m_ProgTrackRequestId = 0;
+    m_JobSteps           = NULL;
+    m_JobNumberOfSteps   = 0;
+    m_JobIndex           = 0;
+    m_JobCallback        = NULL;
+    m_JobHoldOff         = 0;
+    m_JobTicks           = 0;
+    m_BatchCount         = 0;
+    m_BatchIndex         = 0;
+    m_CompositeAddress   = POM_DEFAULT_ADDRESS;
+    m_CompositeCvNumber  = CV_DEFAULT_NUMBER;
+    m_CompositeTicks     = 0;
+    m_Cv29               = CV29_DEFAULT;
+    m_PomReadRetry       = 0;
+
+    start();
+}
+
+/***********************************************************************************************************************
+ * Store the complete module state including the active state.
+ */
+void wmcCv::SnapshotSave(cvSnapshot& Snapshot)
+{
+    Snapshot.State = current_state_ptr;
+    for (uint8_t Index = 0; Index < cvSessionMax; Index++)
+    {
+        Snapshot.Session[Index] = m_Session[Index];
+    }
+    Snapshot.StateId            = m_StateId;
+    Snapshot.RequestId          = m_RequestId;
+    Snapshot.ProgTrackRequestId = m_ProgTrackRequestId;
+    Snapshot.JobSteps           = m_JobSteps;
+    Snapshot.JobNumberOfSteps   = m_JobNumberOfSteps;
+    Snapshot.JobIndex           = m_JobIndex;
+    Snapshot.JobCallback        = m_JobCallback;
+    Snapshot.JobHoldOff         = m_JobHoldOff;
+    Snapshot.JobTicks           = m_JobTicks;
+    for (uint8_t Index = 0; Index < CV_BATCH_MAX; Index++)
+    {
+        Snapshot.Batch[Index] = m_Batch[Index];
+    }
+    Snapshot.BatchCount        = m_BatchCount;
+    Snapshot.BatchIndex        = m_BatchIndex;
+    Snapshot.CompositeAddress  = m_CompositeAddress;
+    Snapshot.CompositeCvNumber = m_CompositeCvNumber;
+    Snapshot.CompositeTicks    = m_CompositeTicks;
+    Snapshot.Cv29              = m_Cv29;
+    Snapshot.PomReadRetry      = m_PomReadRetry;
+    Snapshot.ProgEventSink     = m_ProgEventSink;
+}
+
+/***********************************************************************************************************************
+ * Restore the module state stored with SnapshotSave, no entry or exit actions are executed.
+ */
+void wmcCv::SnapshotRestore(cvSnapshot const& Snapshot)
+{
+    current_state_ptr = Snapshot.State;
+    for (uint8_t Index = 0; Index < cvSessionMax; Index++)
+    {
+        m_Session[Index] = Snapshot.Session[Index];
+    }
+    m_StateId            = Snapshot.StateId;
+    m_RequestId          = Snapshot.RequestId;
+    m_ProgTrackRequestId = Snapshot.ProgTrackRequestId;
+    m_JobSteps           = Snapshot.JobSteps;
+    m_JobNumberOfSteps   = Snapshot.JobNumberOfSteps;
+    m_JobIndex           = Snapshot.JobIndex;
+    m_JobCallback        = Snapshot.JobCallback;
+    m_JobHoldOff         = Snapshot.JobHoldOff;
+    m_JobTicks           = Snapshot.JobTicks;
+    for (uint8_t Index = 0; Index < CV_BATCH_MAX; Index++)
+    {
+        m_Batch[Index] = Snapshot.Batch[Index];
+    }
+    m_BatchCount        = Snapshot.BatchCount;
+    m_BatchIndex        = Snapshot.BatchIndex;
+    m_CompositeAddress  = Snapshot.CompositeAddress;
+    m_CompositeCvNumber = Snapshot.CompositeCvNumber;
+    m_CompositeTicks    = Snapshot.CompositeTicks;
+    m_Cv29              = Snapshot.Cv29;
+    m_PomReadRetry      = Snapshot.PomReadRetry;
+    m_ProgEventSink     = Snapshot.ProgEventSink;
+}
+
+/***********************************************************************************************************************
+ * Check the session data: values within range and at most one programming track request outstanding.
+ */
+bool wmcCv::CheckInvariants(void)
+{
+    uint8_t Outstanding = 0;
+    uint16_t MaxNumber  = CV_MAX_NUMBER_CV_MODE;
+
+    if (m_Ui.PomActive == true)
+    {
+        MaxNumber = CV_MAX_NUMBER;
+    }
+
+    if ((m_Ui.PomAddress < POM_DEFAULT_ADDRESS) || (m_Ui.PomAddress > POM_MAX_ADDRESS))
+    {
+        return false;
+    }
+
+    /* Cv number of previous session is kept in Idle. */
+    if ((m_StateId != cvStateIdle) && ((m_Ui.CvNumber < CV_DEFAULT_NUMBER) || (m_Ui.CvNumber > MaxNumber)))
+    {
+        return false;
+    }
+
+    for (uint8_t Index = 0; Index < cvSessionMax; Index++)
+    {
+        if (m_Session[Index].RequestId != 0)
+        {
+            Outstanding++;
+            if (m_Session[Index].RequestId != m_ProgTrackRequestId)
+            {
+                return false;
+            }
+        }
+    }
+
+    return (Outstanding <= 1);
+}
+
+/***********************************************************************************************************************
+ * Assign a new request id to the session and mark the programming track in use by it.
+ */
+void wmcCv::ClaimProgTrack(cvSession& Session)
+{
+    m_RequestId++;
+    if (m_RequestId == 0)
+    {
+        m_RequestId = 1;
+    }
+
+    Session.RequestId    = m_RequestId;
+    m_ProgTrackRequestId = m_RequestId;
+}
+
+/***********************************************************************************************************************
+ * Release the programming track if in use by the session.
+ */
+void wmcCv::ReleaseProgTrack(cvSession& Session)
+{
+    if ((Session.RequestId != 0) && (Session.RequestId == m_ProgTrackRequestId))
+    {
+        m_ProgTrackRequestId = 0;
+    }
+    Session.RequestId = 0;
+}
+
+/***********************************************************************************************************************
+ * Start a job on the programming track, the first step is send on the next update event. The steps must remain valid
+ * until the job is finished. Not possible when the programming track is in use by interactive cv programming. The
+ * callback can show the progress with JobProgress().
+ *
+ * The job only advances on update events and answers of the command station passed to wmcCv, the application must
+ * keep forwarding them while the job runs, also when the module is in Idle. The user interface leaves with cvExit at
+ * any time, cvProgExit is send by the job when it ends. Without WMC_CV_PROG_EXIT leaving the user interface would
+ * also end programming mode during a request of the job, so no job is started then.
+ */
+bool wmcCv::JobStart(const cvJobStep* Steps, uint16_t NumberOfSteps, cvJobCallback Callback)
+{
+    if ((WMC_CV_PROG_EXIT == 0) || (m_JobSteps != NULL) || (Steps == NULL) || (NumberOfSteps == 0)
+        || (m_ProgTrackRequestId != 0))
+    {
+        return false;
+    }
+
+    if ((m_StateId != cvStateIdle) && (m_Ui.PomActive == false))
+    {
+        return false;
+    }
+
+    /* Refuse the whole job before anything is send when a write is outside the constraint of its cv. */
+    for (uint16_t Index = 0; Index < NumberOfSteps; Index++)
+    {
+        if ((Steps[Index].Operation == cvJobWrite)
+            && (CvValueValid(Steps[Index].CvNumber, Steps[Index].CvValue) == false))
+        {
+            return false;
+        }
+    }
+
+    m_JobSteps         = Steps;
+    m_JobNumberOfSteps = NumberOfSteps;
+    m_JobIndex         = 0;
+    m_JobCallback      = Callback;
+    m_JobHoldOff       = 0;
+    m_JobTicks         = 0;
+    m_Job.RequestId    = 0;
+
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Abort the background job.
+ */
+void wmcCv::JobStop(void)
+{
+    if (m_JobSteps != NULL)
+    {
+        JobEnd();
+    }
+}
+
+/***********************************************************************************************************************
+ * Background job finished or stopped. The command station leaves programming mode, unless the interactive session uses
+ * the programming track, it sends cvProgExit itself when it is left.
+ */
+void wmcCv::JobEnd(void)
+{
+    m_JobSteps = NULL;
+    ReleaseProgTrack(m_Job);
+
+#if WMC_CV_PROG_EXIT == 1
+    if ((m_StateId == cvStateIdle) || (m_Ui.PomActive == true))
+    {
+        SendCvProgEvent(cvProgExit, m_Ui);
+    }
+#endif
+}
+
+/***********************************************************************************************************************
+ * Leave the user interface at once. Programming mode of the command station is left as well, except while the
+ * background job uses the programming track, the job leaves it when it ends.
+ */
+void wmcCv::SendExit(void)
+{
+    SendCvProgEvent(cvExit, m_Ui);
+
+#if WMC_CV_PROG_EXIT == 1
+    if (JobActive() == false)
+    {
+        SendCvProgEvent(cvProgExit, m_Ui);
+    }
+#endif
+}
+
+/***********************************************************************************************************************
+ * Show progress of the background job in the status line while the user interface is active, in Idle the display
+ * belongs to the other modules. To be called from the job callback, the remaining time is estimated from the steps of
+ * this job, so Done and Total may include steps of an earlier job, for example of a resumed program.
+ */
+void wmcCv::JobProgress(const char* Text, uint16_t Done, uint16_t Total)
+{
+    if ((m_JobSteps != NULL) && (m_StateId != cvStateIdle))
+    {
+        UpdateProgress(Text, Done, Total, m_JobTicks, m_JobIndex + 1, WmcTft::color_green);
+    }
+}
+
+/***********************************************************************************************************************
+ * Handle cv events for the background job. While a job is active the programming track belongs to it, so all
+ * programming track answers are consumed here, returns true for those. The request id is not send to the command
+ * station, so an answer is credited to the step outstanding: a cv read answer only when its cv number matches and no
+ * answer at all during the hold off after a step timed out, a late answer of the previous step is ignored then.
+ */
+bool wmcCv::JobHandle(cvEvent const& e)
+{
+    bool Owner = false;
+
+    /* Answers of POM reads never belong to the programming track job. */
+    if ((m_JobSteps == NULL) || (e.address != 0))
+    {
+        return false;
+    }
+
+    Owner = (m_Job.RequestId != 0) && (m_Job.RequestId == m_ProgTrackRequestId);
+
+    switch (e.EventData)
+    {
+    case startCv:
+    case startPom: return false;
+    case update:
+        if (m_JobTicks < 0xFFFF)
+        {
+            m_JobTicks++;
+        }
+
+        if (m_Job.RequestId == 0)
+        {
+            if (m_JobHoldOff > 0)
+            {
+                m_JobHoldOff--;
+            }
+            else
+            {
+                JobSendStep();
+            }
+        }
+        else
+        {
+            m_Job.TimeOutCount++;
+
+            if (m_JobSteps[m_JobIndex].Operation == cvJobRead)
+            {
+                SendCvProgEvent(cvStatusRequest, m_Job);
+
+                if (m_Job.TimeOutCount > TIME_OUT_20_SEC)
+                {
+                    m_JobHoldOff = JOB_HOLD_OFF;
+                    JobStepDone(0, false);
+                }
+            }
+            else if (m_Job.TimeOutCount > TIME_OUT_10_SEC)
+            {
+                m_JobHoldOff = JOB_HOLD_OFF;
+                JobStepDone(0, false);
+            }
+        }
+
+        /* Update is also needed by the interactive session, so never consumed here. */
+        return false;
+    case responseBusy: break;
+    case cvNack:
+    case responseNok:
+        if (Owner == true)
+        {
+            JobStepDone(0, false);
+        }
+        break;
+    case cvData:
+        if ((Owner == true) && (e.cvNumber == m_Job.CvNumber))
+        {
+            JobStepDone(e.cvValue, true);
+        }
+        break;
+    case responseReady:
+        if (Owner == true)
+        {
+            JobStepDone(e.cvValue, true);
+        }
+        break;
+    }
+
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Send the request of the actual step of the background job.
+ */
+void wmcCv::JobSendStep(void)
+{
+    const cvJobStep& Step = m_JobSteps[m_JobIndex];
+
+    m_Job.CvNumber     = Step.CvNumber;
+    m_Job.CvValue      = Step.CvValue;
+    m_Job.TimeOutCount = 0;
+
+    ClaimProgTrack(m_Job);
+
+    if (Step.Operation == cvJobWrite)
+    {
+        SendCvProgEvent(cvWrite, m_Job);
+    }
+    else
+    {
+        SendCvProgEvent(cvRead, m_Job);
+    }
+}
+
+/***********************************************************************************************************************
+ * Report result of actual step of the background job and continue with the next step.
+ */
+void wmcCv::JobStepDone(uint8_t CvValue, bool Ok)
+{
+    uint8_t RequestId = m_Job.RequestId;
+
+    ReleaseProgTrack(m_Job);
+
+    if (m_JobCallback != NULL)
+    {
+        m_JobCallback(RequestId, m_JobIndex, CvValue, Ok);
+    }
+
+    /* Job may be stopped in the callback. */
+    if (m_JobSteps == NULL)
+    {
+        return;
+    }
+
+    m_JobIndex++;
+    if (m_JobIndex >= m_JobNumberOfSteps)
+    {
+        JobEnd();
+    }
+    else if (m_JobHoldOff == 0)
+    {
+        JobSendStep();
+    }
+}
+
+/***********************************************************************************************************************
+ * Redraw the running wheel while waiting on the command station. Each redraw keeps the display bus busy, so the redraw
+ * rate is lowered the longer the wait takes: every tick during the first 2 seconds, every 2nd tick up to 5 seconds and
+ * every 4th tick after that.
+ */
+void wmcCv::UpdateWaiting(cvSession const& Session)
+{
+    uint8_t Divider = 1;
+
+    if (Session.TimeOutCount > WHEEL_QUARTER_RATE_AFTER)
+    {
+        Divider = 4;
+    }
+    else if (Session.TimeOutCount > WHEEL_HALF_RATE_AFTER)
+    {
+        Divider = 2;
+    }
+
+    if ((Session.TimeOutCount % Divider) == 0)
+    {
+        m_wmcCvTft.UpdateRunningWheel(Session.TimeOutCount);
+    }
+}
+
+/***********************************************************************************************************************
+ * Show progress as done / total in the status line, with the remaining time in seconds estimated from the Ticks used
+ * for the last Measured steps. Without measured steps the remaining time is not known yet and left out.
+ */
+void wmcCv::UpdateProgress(
+    const char* Text, uint16_t Done, uint16_t Total, uint16_t Ticks, uint16_t Measured, WmcTft::color Color)
+{
+    char Status[32];
+
+    if ((Measured == 0) || (Done > Total))
+    {
+        snprintf(Status, sizeof(Status), "%s %u/%u", Text, Done, Total);
+    }
+    else
+    {
+        uint32_t Eta = static_cast<uint32_t>(Ticks) * (Total - Done) / Measured / TICKS_PER_SEC;
+        snprintf(Status, sizeof(Status), "%s %u/%u %lus", Text, Done, Total, static_cast<unsigned long>(Eta));
+    }
+
+    m_wmcCvTft.UpdateStatus(Status, true, Color);
+}
+
+/***********************************************************************************************************************
+ * Remove all writes from the batch.
+ */
+void wmcCv::BatchClear(void) { m_BatchCount = 0; }
+
+/***********************************************************************************************************************
+ * Add a write to the batch, refused when the batch is full or the value is outside the constraint of the cv.
+ */
+bool wmcCv::BatchAdd(uint16_t CvNumber, uint8_t CvValue)
+{
+    if ((m_BatchCount >= CV_BATCH_MAX) || (CvValueValid(CvNumber, CvValue) == false))
+    {
+        return false;
+    }
+
+    m_Batch[m_BatchCount].CvNumber  = CvNumber;
+    m_Batch[m_BatchCount].CvValue   = CvValue;
+    m_Batch[m_BatchCount].Operation = cvJobWrite;
+    m_BatchCount++;
+
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Fill the batch with the cv's of a loc address. Addresses up to 127 are written as short address in CV1, higher
+ * addresses as long address in CV17/CV18. CV29 read from the decoder is written with only the long address bit
+ * changed. Returns false when one of the cv's is refused, the batch must not be written then and CV29 is kept.
+ */
+bool wmcCv::BatchAddress(uint16_t Address)
+{
+    bool Ok;
+    uint8_t Cv29 = m_Cv29;
+
+    BatchClear();
+
+    if (Address <= SHORT_ADDRESS_MAX)
+    {
+        Cv29 &= ~CV29_LONG_ADDRESS;
+        Ok = BatchAdd(CV_SHORT_ADDRESS, static_cast<uint8_t>(Address));
+    }
+    else
+    {
+        Cv29 |= CV29_LONG_ADDRESS;
+        Ok = BatchAdd(CV_LONG_ADDRESS_HIGH, static_cast<uint8_t>(LONG_ADDRESS_HIGH_BASE | (Address >> 8)));
+        Ok = BatchAdd(CV_LONG_ADDRESS_LOW, static_cast<uint8_t>(Address & 0xFF)) && Ok;
+    }
+
+    Ok = BatchAdd(CV_CONFIG, Cv29) && Ok;
+    if (Ok == true)
+    {
+        m_Cv29 = Cv29;
+    }
+
+    return Ok;
+}
+
+/***********************************************************************************************************************
+ * Look up the constraint of a cv with a binary search in the table in flash. Returns false when the cv has no
+ * constraint.
+ */
+bool wmcCv::CvConstraintFind(uint16_t CvNumber, cvConstraint& Constraint)
+{
+    uint8_t Low  = 0;
+    uint8_t High = CV_CONSTRAINT_COUNT;
+
+    while (Low < High)
+    {
+        uint8_t Middle  = (Low + High) / 2;
+        uint16_t Number = pgm_read_word(&CvConstraintTable[Middle].CvNumber);
+
+        if (Number == CvNumber)
+        {
+            Constraint.CvNumber = Number;
+            Constraint.Min      = pgm_read_byte(&CvConstraintTable[Middle].Min);
+            Constraint.Max      = pgm_read_byte(&CvConstraintTable[Middle].Max);
+            Constraint.Mask     = pgm_read_byte(&CvConstraintTable[Middle].Mask);
+            return true;
+        }
+
+        if (Number < CvNumber)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return false;
+}
+
+/***********************************************************************************************************************
+ * Check a value against the constraint of the cv.
+ */
+bool wmcCv::CvValueValid(uint16_t CvNumber, uint8_t CvValue)
+{
+    cvConstraint Constraint;
+
+    if (CvConstraintFind(CvNumber, Constraint) == false)
+    {
+        return true;
+    }
+
+    return (CvValue >= Constraint.Min) && (CvValue <= Constraint.Max) && ((CvValue & ~Constraint.Mask) == 0);
+}
+
+/***********************************************************************************************************************
+ * Keep a value changed by the user within the constraint of the cv. Stepping past a limit from the limit itself wraps
+ * to the other limit, a larger step stops at the limit. A value with reserved bits set or a change of a read only cv is
+ * refused and the previous value kept.
+ */
+uint8_t wmcCv::CvValueConstrain(uint16_t CvNumber, uint8_t Previous, uint8_t CvValue)
+{
+    cvConstraint Constraint;
+
+    if (CvConstraintFind(CvNumber, Constraint) == false)
+    {
+        return CvValue;
+    }
+
+    if (Constraint.Min > Constraint.Max)
+    {
+        return Previous;
+    }
+
+    if (CvValue > Constraint.Max)
+    {
+        CvValue = (Previous == Constraint.Max) ? Constraint.Min : Constraint.Max;
+    }
+    else if (CvValue < Constraint.Min)
+    {
+        CvValue = (Previous == Constraint.Min) ? Constraint.Max : Constraint.Min;
+    }
+
+    if ((CvValue & ~Constraint.Mask) != 0)
+    {
+        return Previous;
+    }
+
+    return CvValue;
+}
+
 /***********************************************************************************************************************
  * Default event handlers when not declared in states itself.
  */
 
-void wmcCv::react(cvpulseSwitchEvent const&){};
-void wmcCv::react(cvpushButtonEvent const&){};
-void wmcCv::react(cvEvent const&){};
+void wmcCv::handle(cvpulseSwitchEvent const&){};
+void wmcCv::handle(cvpushButtonEvent const&){};
+void wmcCv::handle(cvEvent const&){};
 
 /***********************************************************************************************************************
  * Initial state.
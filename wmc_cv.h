@@ -17,8 +17,26 @@
 #else
 #include "xmc_event.h"
 #endif
+#include <stddef.h>
 #include <tinyfsm.hpp>
 
+/***********************************************************************************************************************
+ * D E F I N E S
+ **********************************************************************************************************************/
+
+/* Set to 1 when the cvRequest enum of wmc_event.h / xmc_event.h has pomRead and the application forwards it to the
+   command station. Without it button 3 in POM mode does nothing. */
+#ifndef WMC_CV_POM_READ
+#define WMC_CV_POM_READ 0
+#endif
+
+/* Set to 1 when the cvRequest enum of wmc_event.h / xmc_event.h has cvProgExit. cvExit then only leaves the user
+   interface and cvProgExit makes the command station leave programming mode, so a background job keeps the
+   programming track after the user has left. Without it cvExit does both and background jobs are refused. */
+#ifndef WMC_CV_PROG_EXIT
+#define WMC_CV_PROG_EXIT 0
+#endif
+
 /***********************************************************************************************************************
  * T Y P E D  E F S  /  E N U M
  **********************************************************************************************************************/
@@ -38,6 +56,23 @@ enum cvEventData
     responseReady,
 };
 
+/**
+ * States of the cv module, used for tracing.
+ */
+enum cvStateId
+{
+    cvStateIdle = 0,
+    cvStatePomAddress,
+    cvStateCvNumber,
+    cvStateCvValueRead,
+    cvStateCvValueChange,
+    cvStateCvWrite,
+    cvStateCvAddress,
+    cvStateCv29Flags,
+    cvStateCvBatchWrite,
+    cvStateCvCompositeRead,
+};
+
 /**
  * Forwarded pul;se switch event.
  */
@@ -62,8 +97,77 @@ struct cvEvent : tinyfsm::Event
     cvEventData EventData;
     uint16_t cvNumber;
     uint8_t cvValue;
+    uint16_t address = 0; /* Loc address when answer of a POM read, 0 for the programming track. */
+};
+
+/**
+ * Session (job context) of the cv module, packed to 8 bytes.
+ */
+struct cvSession
+{
+    uint16_t PomAddress : 14; /* Address of loc to be changed with POM, max 9999. */
+    uint16_t PomActive : 1;   /* POM mode programming. */
+    uint16_t CvNumber;        /* CV number to be changed. */
+    uint8_t CvValue;          /* Value of CV number. */
+    uint8_t TimeOutCount;     /* Counter for timeout handling. */
+    uint8_t RequestId;        /* Id of outstanding request, 0 when none. */
+};
+
+/**
+ * Valid values of a cv. Cv's without constraint accept all values, a minimum above the maximum marks a read only cv.
+ */
+struct cvConstraint
+{
+    uint16_t CvNumber; /* CV number. */
+    uint8_t Min;       /* Lowest valid value. */
+    uint8_t Max;       /* Highest valid value. */
+    uint8_t Mask;      /* Bits which may be set, reserved bits must be 0. */
+};
+
+/**
+ * Request type of the cv module event to other module.
+ */
+typedef decltype(cvProgEvent::Request) cvProgRequest;
+
+/**
+ * Receiver of the outgoing cv module events, replaces send_event when set.
+ */
+typedef void (*cvProgEventSink)(cvProgEvent const& Event);
+
+/**
+ * Sessions which can be active at the same time.
+ */
+enum cvSessionId
+{
+    cvSessionInteractive = 0, /* Session controlled by the user using the states. */
+    cvSessionBackground,      /* Programming track job running in the background. */
+    cvSessionMax,
 };
 
+/**
+ * Operation of a background job step.
+ */
+enum cvJobOperation
+{
+    cvJobRead = 0,
+    cvJobWrite,
+};
+
+/**
+ * One step of a background job.
+ */
+struct cvJobStep
+{
+    uint16_t CvNumber; /* CV number. */
+    uint8_t CvValue;   /* Value to be written, ignored when reading. */
+    uint8_t Operation; /* See cvJobOperation. */
+};
+
+/**
+ * Result of a background job step, called with the request id, index of the step, value and result.
+ */
+typedef void (*cvJobCallback)(uint8_t RequestId, uint16_t Index, uint8_t CvValue, bool Ok);
+
 /***********************************************************************************************************************
  * C L A S S E S
  **********************************************************************************************************************/
@@ -74,22 +178,69 @@ public:
     /* default reaction for unhandled events */
     void react(tinyfsm::Event const&){};
 
-    virtual void react(cvEvent const&);
-    virtual void react(cvpushButtonEvent const&);
-    virtual void react(cvpulseSwitchEvent const&);
+    /* Events are traced and then forwarded to the handle() of the active state. */
+    void react(cvEvent const&);
+    void react(cvpushButtonEvent const&);
+    void react(cvpulseSwitchEvent const&);
 
     virtual void entry(void){}; /* entry actions in some states */
     virtual void exit(void){};  /* no exit actions at all */
 
-    cvProgEvent EventCvProg; /* Cv module event to other module. */
+    static uint8_t StateId(void) { return m_StateId; }
+    static bool CheckInvariants(void);
+
+    /* Background programming track job, runs next to an interactive POM session. The job is driven by the update
+       events and the answers of the command station, so these must be forwarded while a job runs, also in Idle. */
+    static bool JobStart(const cvJobStep* Steps, uint16_t NumberOfSteps, cvJobCallback Callback);
+    static void JobStop(void);
+    static bool JobActive(void) { return m_JobSteps != NULL; }
+    static cvJobCallback JobCallback(void) { return m_JobCallback; }
+    static void JobProgress(const char* Text, uint16_t Done, uint16_t Total);
+
+    /* Cv value constraints, checked before a write is send. */
+    static bool CvValueValid(uint16_t CvNumber, uint8_t CvValue);
+    static uint8_t CvValueConstrain(uint16_t CvNumber, uint8_t Previous, uint8_t CvValue);
+
+    /* Outgoing events are send to the sink instead of the other modules when set, used by replay and self test. */
+    static void SetProgEventSink(cvProgEventSink Sink) { m_ProgEventSink = Sink; }
+    static void Reset(void);
+
+    static cvProgEvent EventCvProg; /* Cv module event to other module, shared by all states. */
 
 protected:
-    static WmcTft m_wmcCvTft;      /* Display. */
-    static uint16_t m_PomAddress;  /* Address of loc to be changed with POM. */
-    static uint16_t m_cvNumber;    /* CV number to be changed. */
-    static uint16_t m_cvValue;     /* Value of CV number. */
-    static uint8_t m_timeOutCount; /* Counter for timeout handling. */
-    static bool m_PomActive;       /* POM mode programming. */
+    virtual void handle(cvEvent const&);
+    virtual void handle(cvpushButtonEvent const&);
+    virtual void handle(cvpulseSwitchEvent const&);
+
+    static void SendCvProgEvent(cvProgRequest Request, cvSession const& Session);
+    static void ClaimProgTrack(cvSession& Session);
+    static void ReleaseProgTrack(cvSession& Session);
+    static void SendExit(void);
+    static void JobEnd(void);
+    bool JobHandle(cvEvent const& e);
+    void JobSendStep(void);
+    void JobStepDone(uint8_t CvValue, bool Ok);
+    static void UpdateWaiting(cvSession const& Session);
+    static void UpdateProgress(
+        const char* Text, uint16_t Done, uint16_t Total, uint16_t Ticks, uint16_t Measured, WmcTft::color Color);
+    static void BatchClear(void);
+    static bool BatchAdd(uint16_t CvNumber, uint8_t CvValue);
+    static bool BatchAddress(uint16_t Address);
+    static bool CvConstraintFind(uint16_t CvNumber, cvConstraint& Constraint);
+
+    static WmcTft m_wmcCvTft;                 /* Display. */
+    static cvSession m_Session[cvSessionMax]; /* Session data. */
+    static cvSession& m_Ui;                   /* Interactive session. */
+    static cvSession& m_Job;                  /* Background job session. */
+    static uint8_t m_StateId;                 /* Id of active state, see cvStateId. */
+    static uint8_t m_RequestId;               /* Last assigned request id. */
+    static uint8_t m_ProgTrackRequestId;      /* Id of outstanding programming track request, 0 when none. */
+    static const cvJobStep* m_JobSteps;       /* Steps of background job, NULL when no job active. */
+    static uint16_t m_JobNumberOfSteps;       /* Number of steps of background job. */
+    static uint16_t m_JobIndex;               /* Step of background job in progress. */
+    static cvJobCallback m_JobCallback;       /* Result callback of background job. */
+    static uint8_t m_JobHoldOff;              /* Ticks to wait for late answers after a timeout of a job step. */
+    static uint16_t m_JobTicks;               /* Ticks since the background job started. */
 
     static const uint16_t STEP_1              = 1;    /* In - decrease by 1 */
     static const uint16_t STEP_10             = 10;   /* Increase by 10 */
@@ -108,6 +259,64 @@ protected:
     static const uint16_t POM_MAX_ADDRESS = 9999; /* Maximum CV value. */
     static const uint8_t TIME_OUT_20_SEC  = 40;   /* Timeout counter max value based on 0.5sec update. */
     static const uint8_t TIME_OUT_10_SEC  = 20;   /* Timeout counter max value based on 0.5sec update. */
+    static const uint8_t TIME_OUT_2_SEC   = 4;    /* Timeout counter max value based on 0.5sec update. */
+    static const uint8_t POM_READ_RETRIES = 3;    /* Number of repeats of a POM read without answer. */
+    static const uint8_t TICKS_PER_SEC    = 2;    /* Update events per second. */
+    static const uint8_t JOB_HOLD_OFF     = 4;    /* Ticks late answers are ignored after a job step timed out. */
+
+    static const uint8_t WHEEL_HALF_RATE_AFTER    = 4;  /* Ticks after which the wheel is redrawn every 2nd tick. */
+    static const uint8_t WHEEL_QUARTER_RATE_AFTER = 10; /* Ticks after which the wheel is redrawn every 4th tick. */
+
+    static const uint16_t CV_SHORT_ADDRESS      = 1;    /* Short address. */
+    static const uint16_t CV_LONG_ADDRESS_HIGH  = 17;   /* Long address high byte. */
+    static const uint16_t CV_LONG_ADDRESS_LOW   = 18;   /* Long address low byte. */
+    static const uint16_t CV_CONFIG             = 29;   /* Configuration flags. */
+    static const uint16_t SHORT_ADDRESS_MAX     = 127;  /* Highest address written as short address. */
+    static const uint8_t LONG_ADDRESS_HIGH_BASE = 0xC0; /* Upper bits of CV17 for a long address. */
+    static const uint8_t CV29_LONG_ADDRESS      = 0x20; /* CV29 bit for long address. */
+    static const uint8_t CV29_DEFAULT           = 0x06; /* CV29 default, 28/128 speed steps and analog. */
+    static const uint8_t CV_BATCH_MAX           = 3;    /* Maximum number of cv's written in one batch. */
+
+    static cvJobStep m_Batch[CV_BATCH_MAX]; /* Cv's of a composite field written as one batch. */
+    static uint8_t m_BatchCount;            /* Number of cv's in batch. */
+    static uint8_t m_BatchIndex;            /* Next cv of batch to be written. */
+    static uint16_t m_CompositeAddress;     /* Loc address entered in composite address editor. */
+    static uint16_t m_CompositeCvNumber;    /* Cv number the composite editor was opened on. */
+    static uint8_t m_CompositeTicks;        /* Ticks used by the cv's read so far for the composite editor. */
+    static uint8_t m_Cv29;                  /* CV29 configuration flags read from the decoder. */
+    static uint8_t m_PomReadRetry;          /* Number of repeated POM read requests. */
+    static cvProgEventSink m_ProgEventSink; /* Receiver of outgoing events, NULL for the other modules. */
+
+public:
+    /**
+     * Copy of the complete module state, to run the state machine isolated from the live session.
+     */
+    struct cvSnapshot
+    {
+        wmcCv* State;
+        cvSession Session[cvSessionMax];
+        uint8_t StateId;
+        uint8_t RequestId;
+        uint8_t ProgTrackRequestId;
+        const cvJobStep* JobSteps;
+        uint16_t JobNumberOfSteps;
+        uint16_t JobIndex;
+        cvJobCallback JobCallback;
+        uint8_t JobHoldOff;
+        uint16_t JobTicks;
+        cvJobStep Batch[CV_BATCH_MAX];
+        uint8_t BatchCount;
+        uint8_t BatchIndex;
+        uint16_t CompositeAddress;
+        uint16_t CompositeCvNumber;
+        uint8_t CompositeTicks;
+        uint8_t Cv29;
+        uint8_t PomReadRetry;
+        cvProgEventSink ProgEventSink;
+    };
+
+    static void SnapshotSave(cvSnapshot& Snapshot);
+    static void SnapshotRestore(cvSnapshot const& Snapshot);
 };
 
 #endif
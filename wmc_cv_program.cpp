@@ -0,0 +1,229 @@
+/***********************************************************************************************************************
+   @file   wmc_cv_program.cpp
+   @brief  Run named cv programs on the programming track with resumable checkpoints.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv_program.h"
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+cvProgramCheckpointRead WmcCvProgram::m_CheckpointRead   = NULL;
+cvProgramCheckpointWrite WmcCvProgram::m_CheckpointWrite = NULL;
+const cvProgram* WmcCvProgram::m_Program                 = NULL;
+uint16_t WmcCvProgram::m_ProgramId                       = 0;
+uint16_t WmcCvProgram::m_Offset                          = 0;
+uint16_t WmcCvProgram::m_Done                            = 0;
+uint8_t WmcCvProgram::m_Status                           = cvProgramIdle;
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Set the functions to read and write the checkpoint. Without them programs run, but can not be resumed.
+ */
+void WmcCvProgram::Init(cvProgramCheckpointRead Read, cvProgramCheckpointWrite Write)
+{
+    m_CheckpointRead  = Read;
+    m_CheckpointWrite = Write;
+}
+
+/***********************************************************************************************************************
+ * Start a program on the decoder on the programming track. When the checkpoint belongs to this program, the program
+ * resumes at the first step not confirmed after an interruption, otherwise it starts at the first step. A program with
+ * a write outside the constraint of its cv is refused, as are all programs without WMC_CV_PROG_EXIT (see
+ * wmcCv::JobStart()).
+ */
+bool WmcCvProgram::Start(cvProgram const& Program)
+{
+    cvProgramCheckpoint Checkpoint;
+
+    if ((Status() == cvProgramRunning) || (Program.Steps == NULL) || (Program.NumberOfSteps == 0))
+    {
+        return false;
+    }
+
+    m_ProgramId = ProgramId(Program);
+    m_Offset    = 0;
+
+    if ((m_CheckpointRead != NULL) && (m_CheckpointRead(Checkpoint) == true) && (Checkpoint.ProgramId == m_ProgramId)
+        && (Checkpoint.NextStep < Program.NumberOfSteps))
+    {
+        m_Offset = Checkpoint.NextStep;
+    }
+
+    if (wmcCv::JobStart(&Program.Steps[m_Offset], Program.NumberOfSteps - m_Offset, StepResult) == false)
+    {
+        return false;
+    }
+
+    m_Program = &Program;
+    m_Done    = m_Offset;
+    m_Status  = cvProgramRunning;
+
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Stop the program, the checkpoint is kept so the program can be resumed.
+ */
+void WmcCvProgram::Stop(void)
+{
+    if (Running() == true)
+    {
+        wmcCv::JobStop();
+    }
+
+    if (m_Status == cvProgramRunning)
+    {
+        m_Status = cvProgramIdle;
+    }
+}
+
+/***********************************************************************************************************************
+ * Stop the program and clear the checkpoint, the next start begins at the first step. Used when the decoder was
+ * replaced after an interruption.
+ */
+void WmcCvProgram::Clear(void)
+{
+    Stop();
+    StoreCheckpoint(0, 0);
+}
+
+/***********************************************************************************************************************
+ * State of the runner. A program whose job ended without completing, for example stopped with wmcCv::JobStop(), is
+ * no longer running, the checkpoint is kept so the program can be resumed.
+ */
+uint8_t WmcCvProgram::Status(void)
+{
+    if ((m_Status == cvProgramRunning) && (Running() == false))
+    {
+        m_Status = cvProgramIdle;
+    }
+    return m_Status;
+}
+
+/***********************************************************************************************************************
+ * The background job of the program is still active.
+ */
+bool WmcCvProgram::Running(void)
+{
+    return (m_Status == cvProgramRunning) && (wmcCv::JobActive() == true) && (wmcCv::JobCallback() == StepResult);
+}
+
+/***********************************************************************************************************************
+ * Number of steps of the program in progress.
+ */
+uint16_t WmcCvProgram::Total(void)
+{
+    if (m_Program == NULL)
+    {
+        return 0;
+    }
+    return m_Program->NumberOfSteps;
+}
+
+/***********************************************************************************************************************
+ * Id of a program from its name, number of steps and the contents of the steps (FNV-1a folded to 16 bits), never 0.
+ * A changed program gets another id, so it does not resume at the checkpoint of the old one.
+ */
+uint16_t WmcCvProgram::ProgramId(cvProgram const& Program)
+{
+    uint32_t Hash    = 2166136261UL;
+    const char* Name = Program.Name;
+    uint8_t Data[4];
+
+    while ((Name != NULL) && (*Name != '\0'))
+    {
+        Hash ^= static_cast<uint8_t>(*Name);
+        Hash *= 16777619UL;
+        Name++;
+    }
+
+    Hash ^= Program.NumberOfSteps;
+    Hash *= 16777619UL;
+
+    for (uint16_t Index = 0; Index < Program.NumberOfSteps; Index++)
+    {
+        const cvJobStep& Step = Program.Steps[Index];
+
+        Data[0] = static_cast<uint8_t>(Step.CvNumber);
+        Data[1] = static_cast<uint8_t>(Step.CvNumber >> 8);
+        Data[2] = Step.CvValue;
+        Data[3] = Step.Operation;
+
+        for (uint8_t Byte = 0; Byte < sizeof(Data); Byte++)
+        {
+            Hash ^= Data[Byte];
+            Hash *= 16777619UL;
+        }
+    }
+
+    Hash = (Hash >> 16) ^ (Hash & 0xFFFF);
+
+    if (Hash == 0)
+    {
+        Hash = 1;
+    }
+
+    return static_cast<uint16_t>(Hash);
+}
+
+/***********************************************************************************************************************
+ * Write the checkpoint to flash.
+ */
+void WmcCvProgram::StoreCheckpoint(uint16_t ProgramId, uint16_t NextStep)
+{
+    cvProgramCheckpoint Checkpoint;
+
+    if (m_CheckpointWrite != NULL)
+    {
+        Checkpoint.ProgramId = ProgramId;
+        Checkpoint.NextStep  = NextStep;
+        m_CheckpointWrite(Checkpoint);
+    }
+}
+
+/***********************************************************************************************************************
+ * Result of a step of the background job. A confirmed step moves the checkpoint. A failed write or a read with an
+ * unexpected value stops the program and clears the checkpoint, the decoder is replaced then and the next one has to
+ * start at the first step.
+ */
+void WmcCvProgram::StepResult(uint8_t RequestId, uint16_t Index, uint8_t CvValue, bool Ok)
+{
+    (void)RequestId;
+
+    if ((m_Status != cvProgramRunning) || (m_Program == NULL))
+    {
+        return;
+    }
+
+    const cvJobStep& Step = m_Program->Steps[m_Offset + Index];
+
+    if ((Ok == false) || ((Step.Operation == cvJobRead) && (CvValue != Step.CvValue)))
+    {
+        m_Status = cvProgramFailed;
+        StoreCheckpoint(0, 0);
+        wmcCv::JobStop();
+        return;
+    }
+
+    m_Done = m_Offset + Index + 1;
+    wmcCv::JobProgress("PROGRAM", m_Done, Total());
+
+    if (m_Done >= m_Program->NumberOfSteps)
+    {
+        /* Finished, the next decoder starts at the first step again. */
+        StoreCheckpoint(0, 0);
+        m_Status = cvProgramDone;
+    }
+    else
+    {
+        StoreCheckpoint(m_ProgramId, m_Done);
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ **********************************************************************************************************************
+ * @file  wmc_cv_program.h
+ * @brief Run named cv programs on the programming track with resumable checkpoints.
+ ***********************************************************************************************************************
+ */
+#ifndef WMC_CV_PROGRAM_H
+#define WMC_CV_PROGRAM_H
+
+/***********************************************************************************************************************
+ * I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv.h"
+#include <stdint.h>
+
+/***********************************************************************************************************************
+ * T Y P E D  E F S  /  E N U M
+ **********************************************************************************************************************/
+
+/**
+ * Cv program, a list of writes and optional reads. The value of a read step is the expected value, a different value
+ * fails the program.
+ */
+struct cvProgram
+{
+    const char* Name;       /* Name of the program, identifies the checkpoint. */
+    const cvJobStep* Steps; /* Steps of the program. */
+    uint16_t NumberOfSteps; /* Number of steps. */
+};
+
+/**
+ * Progress of a program stored in flash.
+ */
+struct cvProgramCheckpoint
+{
+    uint16_t ProgramId; /* Id of the program, 0 when no program in progress. */
+    uint16_t NextStep;  /* First step not confirmed yet. */
+};
+
+/**
+ * State of the program runner.
+ */
+enum cvProgramStatus
+{
+    cvProgramIdle = 0,
+    cvProgramRunning,
+    cvProgramDone,
+    cvProgramFailed,
+};
+
+/**
+ * Storage of the checkpoint, provided by the application which owns the flash / EEPROM layout.
+ */
+typedef bool (*cvProgramCheckpointRead)(cvProgramCheckpoint& Checkpoint);
+typedef void (*cvProgramCheckpointWrite)(cvProgramCheckpoint const& Checkpoint);
+
+/***********************************************************************************************************************
+ * C L A S S E S
+ **********************************************************************************************************************/
+
+class WmcCvProgram
+{
+public:
+    static void Init(cvProgramCheckpointRead Read, cvProgramCheckpointWrite Write);
+    static bool Start(cvProgram const& Program);
+    static void Stop(void);
+    static void Clear(void);
+    static uint8_t Status(void);
+    static uint16_t Done(void) { return m_Done; }
+    static uint16_t Total(void);
+
+private:
+    static bool Running(void);
+    static uint16_t ProgramId(cvProgram const& Program);
+    static void StoreCheckpoint(uint16_t ProgramId, uint16_t NextStep);
+    static void StepResult(uint8_t RequestId, uint16_t Index, uint8_t CvValue, bool Ok);
+
+    static cvProgramCheckpointRead m_CheckpointRead;   /* Read checkpoint from flash. */
+    static cvProgramCheckpointWrite m_CheckpointWrite; /* Write checkpoint to flash. */
+    static const cvProgram* m_Program;                 /* Program in progress. */
+    static uint16_t m_ProgramId;                       /* Id of program in progress. */
+    static uint16_t m_Offset;                          /* First step of the job, non zero when resumed. */
+    static uint16_t m_Done;                            /* Number of confirmed steps. */
+    static uint8_t m_Status;                           /* See cvProgramStatus. */
+};
+
+#endif
@@ -0,0 +1,376 @@
+/***********************************************************************************************************************
+   @file   wmc_cv_selftest.cpp
+   @brief  Random event self test, dispatch benchmark and simulated command station of the cv module.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv_selftest.h"
+#include <Arduino.h>
+
+#if WMC_CV_SELFTEST == 1
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+uint32_t WmcCvSelfTest::m_Random        = 1;
+uint16_t WmcCvSelfTest::m_ExitCount     = 0;
+uint16_t WmcCvSelfTest::m_ProgExitCount = 0;
+uint16_t WmcCvSelfTest::m_ExitDuringJob = 0;
+uint8_t WmcCvSelfTest::m_StationCv[WMC_CV_SELFTEST_STATION_CVS];
+uint16_t WmcCvSelfTest::m_StationAddress = 0;
+uint8_t WmcCvSelfTest::m_StationDrops    = 0;
+cvProgEvent WmcCvSelfTest::m_StationQueue[WMC_CV_SELFTEST_STATION_QUEUE];
+uint8_t WmcCvSelfTest::m_StationQueueCount = 0;
+bool WmcCvSelfTest::m_StationOverflow      = false;
+cvProgEvent WmcCvSelfTest::m_StationPomWrite;
+
+static const cvEventData SelfTestCvEvents[] = { startCv, startPom, cvNack, cvData, update, responseNok, responseBusy,
+    responseReady };
+
+static const decltype(pulseSwitchEvent::Status) SelfTestPulseSwitch[] = { turn, pushturn, pushedShort, pushedNormal,
+    pushedlong };
+
+static const decltype(pushButtonsEvent::Button) SelfTestButtons[] = { button_0, button_1, button_2, button_3, button_4,
+    button_5, button_power, button_none };
+
+/* Background job started at random, the cv numbers are also used in the random answers. */
+static const cvJobStep SelfTestJob[] = { { 1, 3, cvJobWrite }, { 7, 0, cvJobRead }, { 8, 0, cvJobRead },
+    { 29, 6, cvJobWrite } };
+static const uint16_t SELFTEST_JOB_STEPS = sizeof(SelfTestJob) / sizeof(SelfTestJob[0]);
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Xorshift pseudo random generator, same seed gives the same event sequence.
+ */
+uint32_t WmcCvSelfTest::Random(void)
+{
+    m_Random ^= m_Random << 13;
+    m_Random ^= m_Random >> 17;
+    m_Random ^= m_Random << 5;
+    return m_Random;
+}
+
+/***********************************************************************************************************************
+ * Store a failed check.
+ */
+void WmcCvSelfTest::Fail(cvSelfTestResult& Result, uint8_t Kind)
+{
+    if (Result.Failures == 0)
+    {
+        Result.FirstFailure     = Result.Events;
+        Result.FirstFailureKind = Kind;
+    }
+    Result.Failures++;
+}
+
+/***********************************************************************************************************************
+ * Count the outgoing exit events of the run, they are not send to the other modules.
+ */
+void WmcCvSelfTest::RunSink(cvProgEvent const& Event)
+{
+    if (Event.Request == cvExit)
+    {
+        m_ExitCount++;
+    }
+#if WMC_CV_PROG_EXIT == 1
+    else if (Event.Request == cvProgExit)
+    {
+        m_ProgExitCount++;
+        if (wmcCv::JobActive() == true)
+        {
+            m_ExitDuringJob++;
+        }
+    }
+#endif
+}
+
+/***********************************************************************************************************************
+ * Dispatch random events to the cv module starting in Idle, with background jobs started and stopped at random so
+ * interactive and job requests compete for the programming track. After each event the session invariants are
+ * checked, that the module returning to Idle sent cvExit at once, that cvProgExit is never send during a job and
+ * always when the job ends. The outgoing events are not send to the other modules.
+ */
+void WmcCvSelfTest::Run(uint32_t Seed, uint32_t NumberOfEvents, cvSelfTestResult& Result)
+{
+    uint32_t TimeStamp;
+    uint16_t ExitCount;
+    uint16_t ProgExitCount;
+    uint8_t StateBefore;
+    bool JobBefore;
+
+    Result.Events           = 0;
+    Result.Failures         = 0;
+    Result.FirstFailure     = 0;
+    Result.FirstFailureKind = cvSelfTestOk;
+    Result.DispatchTime     = 0;
+    Result.EventsPerSecond  = 0;
+
+    m_Random        = (Seed == 0) ? 1 : Seed;
+    m_ExitCount     = 0;
+    m_ProgExitCount = 0;
+    m_ExitDuringJob = 0;
+
+    wmcCv::SetProgEventSink(RunSink);
+    wmcCv::Reset();
+
+    while (Result.Events < NumberOfEvents)
+    {
+        uint32_t Value = Random();
+
+        StateBefore   = wmcCv::StateId();
+        JobBefore     = wmcCv::JobActive();
+        ExitCount     = m_ExitCount;
+        ProgExitCount = m_ProgExitCount;
+        TimeStamp     = micros();
+
+        switch (Value % 4)
+        {
+        case 0:
+        {
+            cvEvent Event;
+            Event.EventData = SelfTestCvEvents[(Value >> 8) % (sizeof(SelfTestCvEvents) / sizeof(SelfTestCvEvents[0]))];
+            Event.cvNumber  = static_cast<uint16_t>(Value >> 16);
+            Event.cvValue   = static_cast<uint8_t>(Value >> 4);
+            Event.address   = ((Value & 0x10) != 0) ? 0 : static_cast<uint16_t>(Value >> 30);
+
+            /* Mostly answers on a cv of the job, so the cv number check is passed. */
+            if ((Value & 0x03) != 0)
+            {
+                Event.cvNumber = SelfTestJob[(Value >> 16) % SELFTEST_JOB_STEPS].CvNumber;
+            }
+            wmcCv::dispatch(Event);
+        }
+        break;
+        case 1:
+        {
+            cvpulseSwitchEvent Event;
+            Event.EventData.Status
+                = SelfTestPulseSwitch[(Value >> 8) % (sizeof(SelfTestPulseSwitch) / sizeof(SelfTestPulseSwitch[0]))];
+            Event.EventData.Delta = static_cast<int8_t>((Value >> 16) % 3) - 1;
+            wmcCv::dispatch(Event);
+        }
+        break;
+        case 2:
+        {
+            cvpushButtonEvent Event;
+            Event.EventData.Button
+                = SelfTestButtons[(Value >> 8) % (sizeof(SelfTestButtons) / sizeof(SelfTestButtons[0]))];
+            wmcCv::dispatch(Event);
+        }
+        break;
+        default:
+            if (((Value >> 8) % 8) == 0)
+            {
+                wmcCv::JobStop();
+            }
+            else
+            {
+                wmcCv::JobStart(SelfTestJob, 1 + ((Value >> 16) % SELFTEST_JOB_STEPS), NULL);
+            }
+            break;
+        }
+
+        Result.DispatchTime += micros() - TimeStamp;
+        Result.Events++;
+
+        if (wmcCv::CheckInvariants() == false)
+        {
+            Fail(Result, cvSelfTestInvariant);
+        }
+
+        /* Returning to Idle requires a cvExit during this dispatch, also while the job runs. */
+        if ((StateBefore != cvStateIdle) && (wmcCv::StateId() == cvStateIdle) && (m_ExitCount == ExitCount))
+        {
+            Fail(Result, cvSelfTestExitMissing);
+        }
+
+        /* The user interface never uses the programming track while a job runs, so the job leaves programming mode. */
+        if ((JobBefore == true) && (wmcCv::JobActive() == false) && (m_ProgExitCount == ProgExitCount))
+        {
+            Fail(Result, cvSelfTestProgExitMissing);
+        }
+
+        if (m_ExitDuringJob > 0)
+        {
+            m_ExitDuringJob = 0;
+            Fail(Result, cvSelfTestExitDuringJob);
+        }
+    }
+
+    wmcCv::JobStop();
+    wmcCv::SetProgEventSink(NULL);
+
+    if (Result.DispatchTime > 0)
+    {
+        Result.EventsPerSecond
+            = static_cast<uint32_t>((static_cast<uint64_t>(Result.Events) * 1000000) / Result.DispatchTime);
+    }
+}
+
+/***********************************************************************************************************************
+ * Send an answer of the simulated command station to the cv module.
+ */
+void WmcCvSelfTest::StationAnswer(uint8_t EventData, uint16_t CvNumber, uint8_t CvValue, uint16_t Address)
+{
+    cvEvent Event;
+
+    Event.EventData = static_cast<cvEventData>(EventData);
+    Event.cvNumber  = CvNumber;
+    Event.cvValue   = CvValue;
+    Event.address   = Address;
+    wmcCv::dispatch(Event);
+}
+
+/***********************************************************************************************************************
+ * Outgoing events of the cv module during the POM read, received by the simulated command station instead of the
+ * other modules. Answering here would dispatch into the cv module while it is still sending, so the requests are
+ * queued and answered by StationRespond() after the dispatch.
+ */
+void WmcCvSelfTest::StationSink(cvProgEvent const& Event)
+{
+    if (Event.Request == pomWrite)
+    {
+        m_StationPomWrite = Event;
+    }
+
+    if (m_StationQueueCount < WMC_CV_SELFTEST_STATION_QUEUE)
+    {
+        m_StationQueue[m_StationQueueCount] = Event;
+        m_StationQueueCount++;
+    }
+    else
+    {
+        m_StationOverflow = true;
+    }
+}
+
+/***********************************************************************************************************************
+ * Simulated command station with one decoder, answers the queued requests of the cv module in order. Answers can
+ * cause new requests, so continue until the queue is empty.
+ */
+void WmcCvSelfTest::StationRespond(void)
+{
+    cvProgEvent Request;
+    uint8_t Index;
+
+    while (m_StationQueueCount > 0)
+    {
+        Request = m_StationQueue[0];
+        m_StationQueueCount--;
+        for (Index = 0; Index < m_StationQueueCount; Index++)
+        {
+            m_StationQueue[Index] = m_StationQueue[Index + 1];
+        }
+
+        uint8_t& Cv = m_StationCv[(Request.CvNumber - 1) % WMC_CV_SELFTEST_STATION_CVS];
+
+        switch (Request.Request)
+        {
+        case cvRead: StationAnswer(cvData, Request.CvNumber, Cv, 0); break;
+        case cvWrite:
+            Cv = Request.CvValue;
+            StationAnswer(responseReady, Request.CvNumber, Cv, 0);
+            break;
+        case pomWrite:
+            if (Request.Address == m_StationAddress)
+            {
+                Cv = Request.CvValue;
+            }
+            break;
+#if WMC_CV_POM_READ == 1
+        case pomRead:
+            if (m_StationDrops > 0)
+            {
+                m_StationDrops--;
+            }
+            else if (Request.Address == m_StationAddress)
+            {
+                StationAnswer(cvData, Request.CvNumber, Cv, Request.Address);
+            }
+            break;
+#endif
+        default: break;
+        }
+    }
+}
+
+#if WMC_CV_POM_READ == 1
+/***********************************************************************************************************************
+ * Read a cv of a loc on the main track through the user interface against the simulated command station, which does
+ * not answer the first Drops requests. The read value is checked by writing it back with POM.
+ */
+bool WmcCvSelfTest::PomRead(uint16_t Address, uint16_t CvNumber, uint8_t CvValue, uint8_t Drops)
+{
+    cvEvent Event;
+    cvpulseSwitchEvent Turn;
+    cvpushButtonEvent Button;
+    uint16_t Index;
+    bool Result;
+
+    m_StationAddress = Address;
+    m_StationDrops   = Drops;
+    m_StationCv[(CvNumber - 1) % WMC_CV_SELFTEST_STATION_CVS] = CvValue;
+    m_StationQueueCount       = 0;
+    m_StationOverflow         = false;
+    m_StationPomWrite.Request = cvExit;
+    Turn.EventData.Status     = turn;
+    Turn.EventData.Delta      = 1;
+
+    wmcCv::SetProgEventSink(StationSink);
+    wmcCv::Reset();
+
+    /* Select loc address and cv number. */
+    Event.EventData = startPom;
+    wmcCv::dispatch(Event);
+    for (Index = 1; Index < Address; Index++)
+    {
+        wmcCv::dispatch(Turn);
+    }
+
+    Turn.EventData.Status = pushedNormal;
+    wmcCv::dispatch(Turn);
+
+    Turn.EventData.Status = turn;
+    for (Index = 1; Index < CvNumber; Index++)
+    {
+        wmcCv::dispatch(Turn);
+    }
+
+    Turn.EventData.Status = pushedNormal;
+    wmcCv::dispatch(Turn);
+    StationRespond();
+
+    /* Read, the update events trigger the timeouts and repeats. */
+    Button.EventData.Button = button_3;
+    wmcCv::dispatch(Button);
+    StationRespond();
+
+    Event.EventData = update;
+    for (Index = 0; (Index < 100) && (wmcCv::StateId() == cvStateCvValueRead); Index++)
+    {
+        wmcCv::dispatch(Event);
+        StationRespond();
+    }
+
+    /* Write the read value back and check it. */
+    Button.EventData.Button = button_5;
+    wmcCv::dispatch(Button);
+    StationRespond();
+
+    Result = (m_StationOverflow == false) && (m_StationPomWrite.Request == pomWrite)
+        && (m_StationPomWrite.Address == Address) && (m_StationPomWrite.CvNumber == CvNumber)
+        && (m_StationPomWrite.CvValue == CvValue);
+
+    wmcCv::SetProgEventSink(NULL);
+
+    return Result;
+}
+#endif
+
+#endif
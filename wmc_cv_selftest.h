@@ -0,0 +1,93 @@
+/**
+ **********************************************************************************************************************
+ * @file  wmc_cv_selftest.h
+ * @brief Random event self test, dispatch benchmark and simulated command station of the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef WMC_CV_SELFTEST_H
+#define WMC_CV_SELFTEST_H
+
+/***********************************************************************************************************************
+ * I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv.h"
+#include <stdint.h>
+
+/***********************************************************************************************************************
+ * D E F I N E S
+ **********************************************************************************************************************/
+
+/* Set to 1 to build the self test, not needed in production builds. Run "make" in selftest/ for the host build. */
+#ifndef WMC_CV_SELFTEST
+#define WMC_CV_SELFTEST 0
+#endif
+
+/* Number of cv's of the decoder simulated by the command station. */
+#define WMC_CV_SELFTEST_STATION_CVS 256
+
+/* Number of requests the simulated command station can hold before answering them. */
+#define WMC_CV_SELFTEST_STATION_QUEUE 4
+
+/***********************************************************************************************************************
+ * T Y P E D  E F S  /  E N U M
+ **********************************************************************************************************************/
+
+/**
+ * Checks which can fail during the self test.
+ */
+enum cvSelfTestFailure
+{
+    cvSelfTestOk = 0,          /* No failure. */
+    cvSelfTestInvariant,       /* Session value out of range or more than one request outstanding. */
+    cvSelfTestExitMissing,     /* Back in Idle without sending cvExit. */
+    cvSelfTestExitDuringJob,   /* cvProgExit send while the background job uses the programming track. */
+    cvSelfTestProgExitMissing, /* Background job ended without sending cvProgExit. */
+};
+
+/**
+ * Result of a self test run.
+ */
+struct cvSelfTestResult
+{
+    uint32_t Events;          /* Number of dispatched events. */
+    uint32_t Failures;        /* Number of failed checks. */
+    uint32_t FirstFailure;    /* Event number of first failed check. */
+    uint8_t FirstFailureKind; /* See cvSelfTestFailure. */
+    uint32_t DispatchTime;    /* Total dispatch time in micro seconds. */
+    uint32_t EventsPerSecond; /* Dispatched events per second. */
+};
+
+/***********************************************************************************************************************
+ * C L A S S E S
+ **********************************************************************************************************************/
+
+class WmcCvSelfTest
+{
+public:
+    static void Run(uint32_t Seed, uint32_t NumberOfEvents, cvSelfTestResult& Result);
+#if WMC_CV_POM_READ == 1
+    static bool PomRead(uint16_t Address, uint16_t CvNumber, uint8_t CvValue, uint8_t Drops);
+#endif
+
+private:
+    static uint32_t Random(void);
+    static void Fail(cvSelfTestResult& Result, uint8_t Kind);
+    static void RunSink(cvProgEvent const& Event);
+    static void StationSink(cvProgEvent const& Event);
+    static void StationRespond(void);
+    static void StationAnswer(uint8_t EventData, uint16_t CvNumber, uint8_t CvValue, uint16_t Address);
+
+    static uint32_t m_Random;                                         /* State of the pseudo random generator. */
+    static uint16_t m_ExitCount;                                      /* Number of cvExit send during the run. */
+    static uint16_t m_ProgExitCount;                                  /* Number of cvProgExit send during the run. */
+    static uint16_t m_ExitDuringJob;                                  /* Number of cvProgExit send during a job. */
+    static uint8_t m_StationCv[WMC_CV_SELFTEST_STATION_CVS];          /* Cv's of the simulated decoder. */
+    static uint16_t m_StationAddress;                                 /* Address of the simulated decoder. */
+    static uint8_t m_StationDrops;                                    /* Number of POM reads not answered. */
+    static cvProgEvent m_StationQueue[WMC_CV_SELFTEST_STATION_QUEUE]; /* Requests not answered yet. */
+    static uint8_t m_StationQueueCount;                               /* Number of requests in the queue. */
+    static bool m_StationOverflow;                                    /* Request lost because the queue was full. */
+    static cvProgEvent m_StationPomWrite;                             /* Last pomWrite request received. */
+};
+
+#endif
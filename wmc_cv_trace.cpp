@@ -0,0 +1,235 @@
+/***********************************************************************************************************************
+   @file   wmc_cv_trace.cpp
+   @brief  Event trace recorder and replay of the cv module.
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+   I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv_trace.h"
+#include "wmc_cv.h"
+#include <stdio.h>
+
+/***********************************************************************************************************************
+   D E F I N E S
+ **********************************************************************************************************************/
+
+static_assert((WMC_CV_TRACE_SIZE & (WMC_CV_TRACE_SIZE - 1)) == 0, "WMC_CV_TRACE_SIZE must be a power of 2");
+static_assert(sizeof(cvTraceRecord) == 12, "cvTraceRecord size changed");
+
+/***********************************************************************************************************************
+   D A T A   D E C L A R A T I O N S (exported, local)
+ **********************************************************************************************************************/
+
+cvTraceRecord WmcCvTrace::m_Buffer[WMC_CV_TRACE_SIZE];
+uint32_t WmcCvTrace::m_Head                   = 0;
+bool WmcCvTrace::m_Enabled                    = true;
+const cvTraceRecord* WmcCvTrace::m_ReplayNext = NULL;
+const cvTraceRecord* WmcCvTrace::m_ReplayEnd  = NULL;
+bool WmcCvTrace::m_ReplayOutputDiverged       = false;
+
+/***********************************************************************************************************************
+  F U N C T I O N S
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ * Enable or disable recording, the content of the trace buffer is kept.
+ */
+void WmcCvTrace::Enable(bool Enabled) { m_Enabled = Enabled; }
+
+/***********************************************************************************************************************
+ * Remove all records.
+ */
+void WmcCvTrace::Clear(void) { m_Head = 0; }
+
+/***********************************************************************************************************************
+ * Number of records available in the trace buffer.
+ */
+uint16_t WmcCvTrace::Count(void)
+{
+    if (m_Head > WMC_CV_TRACE_SIZE)
+    {
+        return WMC_CV_TRACE_SIZE;
+    }
+    return static_cast<uint16_t>(m_Head);
+}
+
+/***********************************************************************************************************************
+ * Get a record, index 0 is the oldest record available.
+ */
+bool WmcCvTrace::Get(uint16_t Index, cvTraceRecord& Record)
+{
+    uint16_t Available = Count();
+
+    if (Index >= Available)
+    {
+        return false;
+    }
+
+    Record = m_Buffer[(m_Head - Available + Index) & (WMC_CV_TRACE_SIZE - 1)];
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Write a record as text line, to export the trace over the serial port of the handset and replay it on the host with
+ * the replay tool in selftest/. Index 0 is the oldest record available.
+ */
+bool WmcCvTrace::Format(uint16_t Index, char* Line, uint8_t Size)
+{
+    cvTraceRecord Entry;
+
+    if (Get(Index, Entry) == false)
+    {
+        return false;
+    }
+
+    snprintf(Line, Size, "cvtrace %lu %u %u %u %u %u %u", static_cast<unsigned long>(Entry.TimeStamp), Entry.Kind,
+        Entry.State, Entry.Data, Entry.Number, Entry.Address, Entry.Value);
+    return true;
+}
+
+/***********************************************************************************************************************
+ * Compare an outgoing event of the replayed state machine with the next outgoing event in the trace.
+ */
+void WmcCvTrace::ReplaySink(cvProgEvent const& Event)
+{
+    if ((m_ReplayNext < m_ReplayEnd) && (m_ReplayNext->Data == Event.Request)
+        && (m_ReplayNext->Number == Event.CvNumber) && (m_ReplayNext->Address == Event.Address)
+        && (m_ReplayNext->Value == Event.CvValue))
+    {
+        m_ReplayNext++;
+    }
+    else
+    {
+        m_ReplayOutputDiverged = true;
+    }
+}
+
+/***********************************************************************************************************************
+ * Feed the incoming events of a trace through the state machine again. Replay starts at the first incoming event
+ * recorded in Idle with the module data reset. Outgoing events are not send to the other modules but compared with the
+ * outgoing events recorded after each incoming event. For each replayed event the callback receives the states before
+ * and after dispatching, the dispatch time and the recorded time since the previous transition.
+ *
+ * Only possible in Idle without a background job, afterwards the module state is restored. The display shows the
+ * replayed screens, so the application has to redraw its screen. Returns true when events were replayed without any
+ * divergence, the summary tells whether nothing was replayed or how many events diverged.
+ */
+bool WmcCvTrace::Replay(
+    const cvTraceRecord* Records, uint16_t Count, cvTraceReplayCallback Callback, cvTraceReplaySummary& Summary)
+{
+    cvTraceReplayResult Result;
+    wmcCv::cvSnapshot Snapshot;
+    uint16_t Index     = 0;
+    bool EnabledStored = m_Enabled;
+    uint32_t TransitionStamp;
+
+    Summary.Replayed          = 0;
+    Summary.Divergences       = 0;
+    Summary.OutputDivergences = 0;
+
+    if ((wmcCv::StateId() != cvStateIdle) || (wmcCv::JobActive() == true))
+    {
+        return false;
+    }
+
+    /* Start at the first incoming event recorded in Idle. */
+    while ((Index < Count) && ((Records[Index].Kind == cvTraceProg) || (Records[Index].State != cvStateIdle)))
+    {
+        Index++;
+    }
+
+    if (Index >= Count)
+    {
+        return false;
+    }
+
+    TransitionStamp = Records[Index].TimeStamp;
+
+    /* Do not record the replayed events itself and keep the live session out of the replay. */
+    m_Enabled = false;
+    wmcCv::SnapshotSave(Snapshot);
+    wmcCv::Reset();
+    wmcCv::SetProgEventSink(ReplaySink);
+
+    while (Index < Count)
+    {
+        const cvTraceRecord& Entry = Records[Index];
+
+        /* The outgoing events recorded directly after the incoming event are expected. */
+        m_ReplayNext = &Records[Index + 1];
+        m_ReplayEnd  = m_ReplayNext;
+        while ((m_ReplayEnd < &Records[Count]) && (m_ReplayEnd->Kind == cvTraceProg))
+        {
+            m_ReplayEnd++;
+        }
+        m_ReplayOutputDiverged = false;
+
+        Result.Record         = &Entry;
+        Result.StateBefore    = wmcCv::StateId();
+        Result.Diverged       = (Result.StateBefore != Entry.State);
+        Result.TransitionTime = Entry.TimeStamp - TransitionStamp;
+        Result.DispatchTime   = micros();
+
+        switch (Entry.Kind)
+        {
+        case cvTraceCv:
+        {
+            cvEvent Event;
+            Event.EventData = static_cast<cvEventData>(Entry.Data);
+            Event.cvNumber  = Entry.Number;
+            Event.cvValue   = Entry.Value;
+            Event.address   = Entry.Address;
+            wmcCv::dispatch(Event);
+        }
+        break;
+        case cvTracePulseSwitch:
+        {
+            cvpulseSwitchEvent Event;
+            Event.EventData.Status = static_cast<decltype(Event.EventData.Status)>(Entry.Data);
+            Event.EventData.Delta  = static_cast<int8_t>(Entry.Number);
+            wmcCv::dispatch(Event);
+        }
+        break;
+        case cvTracePushButton:
+        {
+            cvpushButtonEvent Event;
+            Event.EventData.Button = static_cast<decltype(Event.EventData.Button)>(Entry.Data);
+            wmcCv::dispatch(Event);
+        }
+        break;
+        }
+
+        Result.DispatchTime   = micros() - Result.DispatchTime;
+        Result.StateAfter     = wmcCv::StateId();
+        Result.OutputDiverged = (m_ReplayOutputDiverged == true) || (m_ReplayNext != m_ReplayEnd);
+
+        if (Result.StateAfter != Result.StateBefore)
+        {
+            TransitionStamp = Entry.TimeStamp;
+        }
+
+        Summary.Replayed++;
+        if (Result.Diverged == true)
+        {
+            Summary.Divergences++;
+        }
+        if (Result.OutputDiverged == true)
+        {
+            Summary.OutputDivergences++;
+        }
+
+        if (Callback != NULL)
+        {
+            Callback(Result);
+        }
+
+        /* Continue with the next incoming event. */
+        Index = static_cast<uint16_t>(m_ReplayEnd - Records);
+    }
+
+    wmcCv::SnapshotRestore(Snapshot);
+    m_Enabled = EnabledStored;
+
+    return (Summary.Divergences == 0) && (Summary.OutputDivergences == 0);
+}
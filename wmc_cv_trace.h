@@ -0,0 +1,151 @@
+/**
+ **********************************************************************************************************************
+ * @file  wmc_cv_trace.h
+ * @brief Event trace recorder and replay of the cv module.
+ ***********************************************************************************************************************
+ */
+#ifndef WMC_CV_TRACE_H
+#define WMC_CV_TRACE_H
+
+/***********************************************************************************************************************
+ * I N C L U D E S
+ **********************************************************************************************************************/
+#include "wmc_cv.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+/***********************************************************************************************************************
+ * D E F I N E S
+ **********************************************************************************************************************/
+
+/* Number of records in the trace buffer, must be a power of 2. Each record takes 12 bytes of RAM, so the default
+   costs 768 bytes on the ESP8266 and 192 bytes on the XMC. A cv read running into the 20 second timeout takes about
+   90 records (each update and status request is recorded), set 128 to keep one complete sequence when debugging. */
+#ifndef WMC_CV_TRACE_SIZE
+#if APP_CFG_UC == APP_CFG_UC_ESP8266
+#define WMC_CV_TRACE_SIZE 64
+#else
+#define WMC_CV_TRACE_SIZE 16
+#endif
+#endif
+
+/* Size of a record exported as text line by WmcCvTrace::Format, including the terminating 0. */
+#define WMC_CV_TRACE_LINE_SIZE 48
+
+/* Set to 0 to remove the recorder completely. */
+#ifndef WMC_CV_TRACE_ENABLE
+#define WMC_CV_TRACE_ENABLE 1
+#endif
+
+/***********************************************************************************************************************
+ * T Y P E D  E F S  /  E N U M
+ **********************************************************************************************************************/
+
+/**
+ * Kind of traced event.
+ */
+enum cvTraceKind
+{
+    cvTraceCv = 0,      /* Incoming cvEvent. */
+    cvTracePulseSwitch, /* Incoming cvpulseSwitchEvent. */
+    cvTracePushButton,  /* Incoming cvpushButtonEvent. */
+    cvTraceProg,        /* Outgoing cvProgEvent. */
+};
+
+/**
+ * One traced event, 12 bytes.
+ */
+struct cvTraceRecord
+{
+    uint32_t TimeStamp; /* millis() when the event was recorded. */
+    uint16_t Number;    /* Cv number, or pulse switch delta. */
+    uint16_t Address;   /* Loc address of outgoing event or POM read answer. */
+    uint8_t Kind;       /* See cvTraceKind. */
+    uint8_t State;      /* State of wmcCv when the event was recorded, see cvStateId. */
+    uint8_t Data;       /* Event data, pulse switch status, button or request. */
+    uint8_t Value;      /* Cv value. */
+};
+
+/**
+ * Result of replaying one incoming event.
+ */
+struct cvTraceReplayResult
+{
+    const cvTraceRecord* Record; /* Replayed record. */
+    uint8_t StateBefore;         /* State of wmcCv before dispatching the event. */
+    uint8_t StateAfter;          /* State of wmcCv after dispatching the event. */
+    uint32_t DispatchTime;       /* Dispatch time in micro seconds. */
+    uint32_t TransitionTime;     /* Recorded milli seconds since the previous transition or the start of the replay. */
+    bool Diverged;               /* State before dispatching differs from the recorded state. */
+    bool OutputDiverged;         /* Outgoing events differ from the recorded outgoing events. */
+};
+
+/**
+ * Summary of a replay.
+ */
+struct cvTraceReplaySummary
+{
+    uint16_t Replayed;          /* Replayed incoming events, 0 when nothing could be replayed. */
+    uint16_t Divergences;       /* Events where the state before dispatching differs from the trace. */
+    uint16_t OutputDivergences; /* Events where the outgoing events differ from the trace. */
+};
+
+typedef void (*cvTraceReplayCallback)(cvTraceReplayResult const&);
+
+/***********************************************************************************************************************
+ * C L A S S E S
+ **********************************************************************************************************************/
+
+class WmcCvTrace
+{
+public:
+    /**
+     * Store an event in the trace buffer, oldest records are overwritten.
+     */
+    static inline void Record(
+        uint8_t Kind, uint8_t State, uint8_t Data, uint16_t Number, uint16_t Address, uint8_t Value)
+    {
+#if WMC_CV_TRACE_ENABLE == 1
+        if (m_Enabled)
+        {
+            cvTraceRecord& Entry = m_Buffer[m_Head & (WMC_CV_TRACE_SIZE - 1)];
+            Entry.TimeStamp      = millis();
+            Entry.Number         = Number;
+            Entry.Address        = Address;
+            Entry.Kind           = Kind;
+            Entry.State          = State;
+            Entry.Data           = Data;
+            Entry.Value          = Value;
+            m_Head++;
+        }
+#else
+        (void)Kind;
+        (void)State;
+        (void)Data;
+        (void)Number;
+        (void)Address;
+        (void)Value;
+#endif
+    }
+
+    static void Enable(bool Enabled);
+    static void Clear(void);
+    static uint16_t Count(void);
+    static uint32_t Total(void) { return m_Head; }
+    static bool Get(uint16_t Index, cvTraceRecord& Record);
+    static bool Format(uint16_t Index, char* Line, uint8_t Size);
+    static bool Replay(
+        const cvTraceRecord* Records, uint16_t Count, cvTraceReplayCallback Callback, cvTraceReplaySummary& Summary);
+
+private:
+    static void ReplaySink(cvProgEvent const& Event);
+
+    static cvTraceRecord m_Buffer[WMC_CV_TRACE_SIZE]; /* Ring buffer with records. */
+    static uint32_t m_Head;                           /* Total number of recorded events. */
+    static bool m_Enabled;                            /* Recording active. */
+    static const cvTraceRecord* m_ReplayNext;         /* Next recorded outgoing event expected during replay. */
+    static const cvTraceRecord* m_ReplayEnd;          /* End of recorded outgoing events of replayed event. */
+    static bool m_ReplayOutputDiverged;               /* Outgoing event of replayed event differs from the trace. */
+};
+
+#endif